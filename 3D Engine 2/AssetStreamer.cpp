@@ -0,0 +1,274 @@
+#include "AssetStreamer.h"
+
+TextureAsset::TextureAsset(const std::string& filename, int compression)
+	:
+	surface(filename)
+{
+	// converted textures already carry their mip maps
+	if (surface.GetPixels() != nullptr) {
+
+		surface.GenerateMipMaps();
+
+		// streamed textures are read only
+		if (compression != SURFACE_UNCOMPRESSED && surface.GetCompression() == SURFACE_UNCOMPRESSED)
+			surface.Compress(compression);
+		else
+			surface.SetLayout(SURFACE_MORTON);
+	}
+}
+
+size_t TextureAsset::GetMemoryUsage() const {
+	return surface.GetMemoryUsage();
+}
+
+AssetStreamer::AssetStreamer(size_t memoryBudget)
+	:
+	memoryBudget(memoryBudget)
+{
+	loadingThread = std::thread(&AssetStreamer::LoadingLoop, this);
+}
+
+AssetStreamer::~AssetStreamer() {
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		quit = true;
+	}
+
+	queueCondition.notify_one();
+	loadingThread.join();
+
+	for (int h = 0; h < numSlots; ++h) {
+
+		delete slots[h].asset.load();
+		delete slots[h].placeholder;
+	}
+
+	for (StreamedAsset* asset : retired)
+		delete asset;
+
+	for (const ReleasedAsset& released : releasing)
+		delete released.asset;
+
+}
+
+AssetStreamer::Handle AssetStreamer::Request(const Loader& load) {
+
+	Handle handle = numSlots.fetch_add(1);
+
+	if (handle >= MAX_STREAMED_ASSETS) {
+		--numSlots;
+		return -1;
+	}
+
+	slots[handle].load = load;
+	Enqueue(handle);
+
+	return handle;
+
+}
+
+AssetStreamer::Handle AssetStreamer::RequestTexture(const std::string& filename, const Vec4& placeholderColor, int compression) {
+
+	Surface* placeholder = new Surface(1, 1);
+	placeholder->PutPixel(0, 0, placeholderColor);
+
+	Handle handle = Request([filename, compression](const Publisher&) -> StreamedAsset* {
+
+		TextureAsset* texture = new TextureAsset(filename, compression);
+
+		// the image could not be read
+		if (texture->surface.GetPixels() == nullptr) {
+			delete texture;
+			return nullptr;
+		}
+
+		return texture;
+	});
+
+	if (handle < 0)
+		delete placeholder;
+	else
+		slots[handle].placeholder = placeholder;
+
+	return handle;
+
+}
+
+void AssetStreamer::Enqueue(Handle handle) {
+
+	// only one request per asset can be waiting
+	int expected = UNLOADED;
+	if (!slots[handle].state.compare_exchange_strong(expected, QUEUED))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back(handle);
+	}
+
+	queueCondition.notify_one();
+
+}
+
+void AssetStreamer::LoadingLoop() {
+
+	while (true) {
+
+		Handle handle;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return quit || !queue.empty(); });
+
+			if (quit)
+				return;
+
+			handle = queue.front();
+			queue.pop_front();
+		}
+
+		Slot& slot = slots[handle];
+		slot.state = LOADING;
+
+		StreamedAsset* asset = slot.load([this, handle](StreamedAsset* partial) { Publish(handle, partial); });
+
+		if (asset == nullptr) {
+			slot.state = FAILED;
+			continue;
+		}
+
+		Publish(handle, asset);
+		slot.state = LOADED;
+	}
+
+}
+
+void AssetStreamer::Publish(Handle handle, StreamedAsset* asset) {
+
+	StreamedAsset* previous = slots[handle].asset.exchange(asset, std::memory_order_acq_rel);
+
+	// the render thread may still be drawing the old version
+	if (previous != nullptr) {
+		std::lock_guard<std::mutex> lock(retiredMutex);
+		retired.push_back(previous);
+	}
+
+}
+
+StreamedAsset* AssetStreamer::Acquire(Handle handle) {
+
+	if (handle < 0)
+		return nullptr;
+
+	Slot& slot = slots[handle];
+	slot.lastUsed.store(frame, std::memory_order_relaxed);
+
+	StreamedAsset* asset = slot.asset.load(std::memory_order_acquire);
+
+	// it was evicted, bring it back
+	if (asset == nullptr && slot.state == UNLOADED)
+		Enqueue(handle);
+
+	return asset;
+
+}
+
+const Surface& AssetStreamer::GetTexture(Handle handle) {
+
+	const TextureAsset* texture = Get<TextureAsset>(handle);
+
+	if (texture != nullptr)
+		return texture->surface;
+
+	// a full streamer hands out -1, and handles from Request have no placeholder
+	if (handle < 0 || slots[handle].placeholder == nullptr) {
+
+		static const Surface fallback = [] {
+			Surface white(1, 1);
+			white.WhiteOut();
+			return white;
+		}();
+
+		return fallback;
+	}
+
+	return *slots[handle].placeholder;
+
+}
+
+bool AssetStreamer::IsLoaded(Handle handle) const {
+	return handle >= 0 && slots[handle].state == LOADED;
+}
+
+long long AssetStreamer::EndFrame() {
+
+	std::lock_guard<std::mutex> lock(retiredMutex);
+
+	for (StreamedAsset* asset : retired)
+		releasing.push_back({ asset, frame });
+
+	retired.clear();
+
+	int count = numSlots < MAX_STREAMED_ASSETS ? (int)numSlots : MAX_STREAMED_ASSETS;
+
+	memoryUsage = 0;
+	for (int h = 0; h < count; ++h) {
+
+		StreamedAsset* asset = slots[h].asset.load(std::memory_order_acquire);
+		if (asset != nullptr)
+			memoryUsage += asset->GetMemoryUsage();
+	}
+
+	// evict the least recently used finished assets, never ones used this frame
+	while (memoryUsage > memoryBudget) {
+
+		int oldest = -1;
+
+		for (int h = 0; h < count; ++h) {
+
+			if (slots[h].state != LOADED || slots[h].lastUsed >= frame)
+				continue;
+
+			if (oldest == -1 || slots[h].lastUsed < slots[oldest].lastUsed)
+				oldest = h;
+		}
+
+		if (oldest == -1)
+			break;
+
+		StreamedAsset* asset = slots[oldest].asset.exchange(nullptr, std::memory_order_acq_rel);
+		slots[oldest].state = UNLOADED;
+
+		memoryUsage -= asset->GetMemoryUsage();
+		releasing.push_back({ asset, frame });
+	}
+
+	return frame++;
+
+}
+
+void AssetStreamer::ReleaseFrame(long long frame) {
+
+	std::lock_guard<std::mutex> lock(retiredMutex);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < releasing.size(); ++i) {
+
+		if (releasing[i].frame <= frame)
+			delete releasing[i].asset;
+		else
+			releasing[kept++] = releasing[i];
+	}
+
+	releasing.resize(kept);
+
+}
+
+void AssetStreamer::SetMemoryBudget(size_t bytes) {
+	memoryBudget = bytes;
+}
+
+size_t AssetStreamer::GetMemoryUsage() const {
+	return memoryUsage;
+}
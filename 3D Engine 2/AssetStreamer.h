@@ -0,0 +1,154 @@
+#pragma once
+#include "Surface.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <string>
+
+// most assets one streamer can track
+#define MAX_STREAMED_ASSETS 256
+
+// bytes of loaded assets kept before the least recently used are evicted
+#define DEFAULT_STREAMING_BUDGET (256 << 20)
+
+// anything the streamer can load
+class StreamedAsset {
+
+public:
+
+	virtual ~StreamedAsset() {}
+
+	// bytes counted against the streamer's budget
+	virtual size_t GetMemoryUsage() const = 0;
+
+};
+
+class TextureAsset : public StreamedAsset {
+
+public:
+
+	Surface surface;
+
+	TextureAsset(const std::string& filename, int compression = SURFACE_UNCOMPRESSED);
+
+	size_t GetMemoryUsage() const override;
+
+};
+
+// Loads assets on a background thread.
+// Requests return a handle right away, and until the asset arrives Get returns
+// nothing and GetTexture returns a 1x1 placeholder. Loaders publish finished assets
+// with an atomic pointer swap, the render thread never waits on a lock to draw.
+//
+// Get, GetTexture and EndFrame must all be called from the thread recording the frame.
+// EndFrame returns the frame it ended, replaced and evicted assets are freed once
+// ReleaseFrame is called with it, so pointers returned during a frame stay valid until
+// whoever draws that frame, which may be a later thread, is done with it.
+class AssetStreamer {
+
+public:
+
+	typedef int Handle;
+
+	// may be called any number of times with progressively better versions of an asset
+	typedef std::function<void(StreamedAsset*)> Publisher;
+
+	// runs on the loading thread and returns the final asset, or nullptr if it failed
+	typedef std::function<StreamedAsset*(const Publisher& publish)> Loader;
+
+private:
+
+	enum {
+		UNLOADED,
+		QUEUED,
+		LOADING,
+		LOADED,
+		FAILED
+	};
+
+	struct Slot {
+
+		std::atomic<StreamedAsset*> asset{ nullptr };
+		std::atomic<int> state{ UNLOADED };
+
+		// last frame the asset was asked for
+		std::atomic<long long> lastUsed{ 0 };
+
+		Loader load;
+
+		// only for textures
+		Surface* placeholder = nullptr;
+
+	};
+
+	Slot slots[MAX_STREAMED_ASSETS];
+	std::atomic<int> numSlots{ 0 };
+
+	std::thread loadingThread;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<Handle> queue;
+	bool quit = false;
+
+	struct ReleasedAsset {
+		StreamedAsset* asset;
+		long long frame;
+	};
+
+	// versions that have been replaced, handed to releasing at the end of the frame
+	std::mutex retiredMutex;
+	std::vector<StreamedAsset*> retired;
+	// replaced and evicted assets waiting for ReleaseFrame, also under retiredMutex
+	std::vector<ReleasedAsset> releasing;
+
+	size_t memoryBudget;
+	size_t memoryUsage = 0;
+
+	long long frame = 1;
+
+	void LoadingLoop();
+	void Enqueue(Handle handle);
+	void Publish(Handle handle, StreamedAsset* asset);
+
+	StreamedAsset* Acquire(Handle handle);
+
+public:
+
+	AssetStreamer(size_t memoryBudget = DEFAULT_STREAMING_BUDGET);
+	~AssetStreamer();
+
+	AssetStreamer(const AssetStreamer&) = delete;
+	AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+	// queues a load, returns -1 if the streamer is full
+	Handle Request(const Loader& load);
+	// images that are not already compressed are compressed to the given format once loaded
+	Handle RequestTexture(const std::string& filename, const Vec4& placeholderColor = { 1, 1, 1, 1 }, int compression = SURFACE_UNCOMPRESSED);
+
+	// nullptr until the asset has been published
+	template <class T>
+	const T* Get(Handle handle) {
+		return static_cast<const T*>(Acquire(handle));
+	}
+
+	// the placeholder until the texture is published, or a 1x1 white surface
+	// for -1 and handles that were not requested with RequestTexture
+	const Surface& GetTexture(Handle handle);
+
+	bool IsLoaded(Handle handle) const;
+
+	// evicts the least recently used assets while over budget and returns the frame
+	// that ended, nothing is freed until that frame is passed to ReleaseFrame
+	long long EndFrame();
+	// frees assets replaced or evicted up to and including frame, from any thread
+	void ReleaseFrame(long long frame);
+
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryUsage() const;
+
+};
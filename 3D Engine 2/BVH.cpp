@@ -0,0 +1,552 @@
+#include "BVH.h"
+#include <math.h>
+#include <algorithm>
+#include <assert.h>
+
+BVH::BVH() {
+
+	nodes.reserve(16);
+
+}
+
+int BVH::AllocateNode() {
+
+	// grow the pool and thread the new nodes onto the free list
+	if (freeList == BVH_NULL) {
+
+		int oldSize = (int)nodes.size();
+		int newSize = oldSize == 0 ? 16 : oldSize * 2;
+
+		nodes.resize(newSize);
+
+		for (int i = oldSize; i < newSize; ++i) {
+			nodes[i].parent = i + 1 < newSize ? i + 1 : BVH_NULL;
+			nodes[i].height = -1;
+		}
+
+		freeList = oldSize;
+	}
+
+	int node = freeList;
+	freeList = nodes[node].parent;
+
+	nodes[node].parent = BVH_NULL;
+	nodes[node].child1 = BVH_NULL;
+	nodes[node].child2 = BVH_NULL;
+	nodes[node].height = 0;
+	nodes[node].userData = nullptr;
+
+	return node;
+
+}
+
+void BVH::FreeNode(int node) {
+
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+
+}
+
+int BVH::Insert(const AABB& box, void* userData) {
+
+	int proxy = AllocateNode();
+
+	nodes[proxy].box = box.Expanded(BVH_MARGIN);
+	nodes[proxy].userData = userData;
+	nodes[proxy].height = 0;
+
+	InsertLeaf(proxy);
+	++numProxies;
+
+	return proxy;
+
+}
+
+void BVH::Remove(int proxy) {
+
+	assert(proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--numProxies;
+
+}
+
+bool BVH::Move(int proxy, const AABB& box) {
+
+	assert(proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].IsLeaf());
+
+	// the object is still inside its fat box, the tree does not change
+	if (nodes[proxy].box.Contains(box))
+		return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = box.Expanded(BVH_MARGIN);
+	InsertLeaf(proxy);
+
+	return true;
+
+}
+
+void* BVH::GetUserData(int proxy) const {
+	return nodes[proxy].userData;
+}
+
+const AABB& BVH::GetFatBox(int proxy) const {
+	return nodes[proxy].box;
+}
+
+int BVH::NumProxies() const {
+	return numProxies;
+}
+
+int BVH::GetHeight() const {
+	return root == BVH_NULL ? 0 : nodes[root].height;
+}
+
+void BVH::InsertLeaf(int leaf) {
+
+	if (root == BVH_NULL) {
+		root = leaf;
+		nodes[root].parent = BVH_NULL;
+		return;
+	}
+
+	// find the best sibling for the leaf using the surface area heuristic
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+
+	while (!nodes[index].IsLeaf()) {
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = nodes[index].box.SurfaceArea();
+		float combinedArea = nodes[index].box.Union(leafBox).SurfaceArea();
+
+		// cost of creating a new parent for this node and the new leaf
+		float cost = 2 * combinedArea;
+
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2 * (combinedArea - area);
+
+		float cost1 = nodes[child1].box.Union(leafBox).SurfaceArea() + inheritanceCost;
+		if (!nodes[child1].IsLeaf())
+			cost1 -= nodes[child1].box.SurfaceArea();
+
+		float cost2 = nodes[child2].box.Union(leafBox).SurfaceArea() + inheritanceCost;
+		if (!nodes[child2].IsLeaf())
+			cost2 -= nodes[child2].box.SurfaceArea();
+
+		// descending further is not worth it
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// allocating can move the node pool, so no references are held across this
+	int newParent = AllocateNode();
+	int oldParent = nodes[sibling].parent;
+
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = leafBox.Union(nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != BVH_NULL) {
+
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else {
+		root = newParent;
+	}
+
+	// walk back up the tree refitting boxes and rebalancing
+	index = nodes[leaf].parent;
+	while (index != BVH_NULL) {
+
+		index = Balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = nodes[child1].box.Union(nodes[child2].box);
+
+		index = nodes[index].parent;
+	}
+
+}
+
+void BVH::RemoveLeaf(int leaf) {
+
+	if (leaf == root) {
+		root = BVH_NULL;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent == BVH_NULL) {
+
+		// the sibling becomes the whole tree
+		root = sibling;
+		nodes[sibling].parent = BVH_NULL;
+		FreeNode(parent);
+		return;
+	}
+
+	// destroy the parent and connect the sibling to the grand parent
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+
+	nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	// refit the ancestors
+	int index = grandParent;
+	while (index != BVH_NULL) {
+
+		index = Balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		nodes[index].box = nodes[child1].box.Union(nodes[child2].box);
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+
+		index = nodes[index].parent;
+	}
+
+}
+
+int BVH::Balance(int iA) {
+
+	// performs a left or right rotation if node A is imbalanced
+	// returns the node that now sits where A was
+
+	Node& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2)
+		return iA;
+
+	int iB = A.child1;
+	int iC = A.child2;
+
+	Node& B = nodes[iB];
+	Node& C = nodes[iC];
+
+	int balance = C.height - B.height;
+
+	// rotate C up
+	if (balance > 1) {
+
+		int iF = C.child1;
+		int iG = C.child2;
+
+		Node& F = nodes[iF];
+		Node& G = nodes[iG];
+
+		// swap A and C
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		// A's old parent should point to C
+		if (C.parent != BVH_NULL) {
+
+			if (nodes[C.parent].child1 == iA)
+				nodes[C.parent].child1 = iC;
+			else
+				nodes[C.parent].child2 = iC;
+		}
+		else {
+			root = iC;
+		}
+
+		// rotate the taller of C's children up with it
+		if (F.height > G.height) {
+
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+
+			A.box = B.box.Union(G.box);
+			C.box = A.box.Union(F.box);
+
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else {
+
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+
+			A.box = B.box.Union(F.box);
+			C.box = A.box.Union(G.box);
+
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if (balance < -1) {
+
+		int iD = B.child1;
+		int iE = B.child2;
+
+		Node& D = nodes[iD];
+		Node& E = nodes[iE];
+
+		// swap A and B
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		// A's old parent should point to B
+		if (B.parent != BVH_NULL) {
+
+			if (nodes[B.parent].child1 == iA)
+				nodes[B.parent].child1 = iB;
+			else
+				nodes[B.parent].child2 = iB;
+		}
+		else {
+			root = iB;
+		}
+
+		// rotate the taller of B's children up with it
+		if (D.height > E.height) {
+
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+
+			A.box = C.box.Union(E.box);
+			B.box = A.box.Union(D.box);
+
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else {
+
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+
+			A.box = C.box.Union(D.box);
+			B.box = A.box.Union(E.box);
+
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+
+}
+
+static bool BoxOutsidePlane(const AABB& box, const Plane& plane) {
+
+	// the corner furthest along the plane normal
+	Vec3 positive(
+		plane.normal.x >= 0 ? box.max.x : box.min.x,
+		plane.normal.y >= 0 ? box.max.y : box.min.y,
+		plane.normal.z >= 0 ? box.max.z : box.min.z
+	);
+
+	return plane.Distance(positive) < 0;
+
+}
+
+static bool BoxInsidePlane(const AABB& box, const Plane& plane) {
+
+	// the corner furthest against the plane normal
+	Vec3 negative(
+		plane.normal.x >= 0 ? box.min.x : box.max.x,
+		plane.normal.y >= 0 ? box.min.y : box.max.y,
+		plane.normal.z >= 0 ? box.min.z : box.max.z
+	);
+
+	return plane.Distance(negative) >= 0;
+
+}
+
+void BVH::QueryFrustum(const Mat4& viewProjection, std::vector<int>& results) const {
+
+	if (root == BVH_NULL)
+		return;
+
+	Plane planes[6];
+	ExtractFrustumPlanes(viewProjection, planes);
+
+	// second half of each entry is set when the node is known to be
+	// completely inside the frustum, so its subtree skips the plane tests
+	int stack[BVH_STACK_SIZE];
+	bool inside[BVH_STACK_SIZE];
+	int count = 0;
+
+	stack[count] = root;
+	inside[count++] = false;
+
+	while (count > 0) {
+
+		--count;
+		int index = stack[count];
+		bool fullyInside = inside[count];
+
+		const Node& node = nodes[index];
+
+		if (!fullyInside) {
+
+			bool rejected = false;
+			fullyInside = true;
+
+			for (int i = 0; i < 6; ++i) {
+
+				if (BoxOutsidePlane(node.box, planes[i])) {
+					rejected = true;
+					break;
+				}
+
+				if (!BoxInsidePlane(node.box, planes[i]))
+					fullyInside = false;
+			}
+
+			// if any plane rejected the box, skip the subtree
+			if (rejected)
+				continue;
+		}
+
+		if (node.IsLeaf()) {
+			results.push_back(index);
+			continue;
+		}
+
+		assert(count + 2 <= BVH_STACK_SIZE);
+
+		stack[count] = node.child1;
+		inside[count++] = fullyInside;
+		stack[count] = node.child2;
+		inside[count++] = fullyInside;
+	}
+
+}
+
+void BVH::QueryRay(const Vec3& origin, const Vec3& direction, float maxDistance, std::vector<int>& results) const {
+
+	if (root == BVH_NULL)
+		return;
+
+	// tiny direction components are pushed away from zero so fast floating
+	// point math never sees 0 * infinity in the slab test
+	Vec3 invDir(
+		1.0f / (fabsf(direction.x) > 1e-12f ? direction.x : 1e-12f),
+		1.0f / (fabsf(direction.y) > 1e-12f ? direction.y : 1e-12f),
+		1.0f / (fabsf(direction.z) > 1e-12f ? direction.z : 1e-12f)
+	);
+
+	std::vector<std::pair<float, int>> hits;
+
+	int stack[BVH_STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0) {
+
+		int index = stack[--count];
+		const Node& node = nodes[index];
+
+		// slab test, from section 5.3.3, "Real-Time Collision Detection", Ericson
+		float t1 = (node.box.min.x - origin.x) * invDir.x;
+		float t2 = (node.box.max.x - origin.x) * invDir.x;
+		float tNear = fminf(t1, t2);
+		float tFar = fmaxf(t1, t2);
+
+		t1 = (node.box.min.y - origin.y) * invDir.y;
+		t2 = (node.box.max.y - origin.y) * invDir.y;
+		tNear = fmaxf(tNear, fminf(t1, t2));
+		tFar = fminf(tFar, fmaxf(t1, t2));
+
+		t1 = (node.box.min.z - origin.z) * invDir.z;
+		t2 = (node.box.max.z - origin.z) * invDir.z;
+		tNear = fmaxf(tNear, fminf(t1, t2));
+		tFar = fminf(tFar, fmaxf(t1, t2));
+
+		if (tFar < tNear || tFar < 0 || tNear > maxDistance)
+			continue;
+
+		if (node.IsLeaf()) {
+			hits.push_back({ fmaxf(tNear, 0), index });
+			continue;
+		}
+
+		assert(count + 2 <= BVH_STACK_SIZE);
+
+		stack[count++] = node.child1;
+		stack[count++] = node.child2;
+	}
+
+	std::sort(hits.begin(), hits.end());
+
+	for (const auto& hit : hits)
+		results.push_back(hit.second);
+
+}
+
+void BVH::QuerySphere(const Vec3& center, float radius, std::vector<int>& results) const {
+
+	if (root == BVH_NULL)
+		return;
+
+	float radiusSquared = radius * radius;
+
+	int stack[BVH_STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0) {
+
+		int index = stack[--count];
+		const Node& node = nodes[index];
+
+		// squared distance from the center to the closest point on the box
+		float dx = fmaxf(fmaxf(node.box.min.x - center.x, 0), center.x - node.box.max.x);
+		float dy = fmaxf(fmaxf(node.box.min.y - center.y, 0), center.y - node.box.max.y);
+		float dz = fmaxf(fmaxf(node.box.min.z - center.z, 0), center.z - node.box.max.z);
+
+		if (dx * dx + dy * dy + dz * dz > radiusSquared)
+			continue;
+
+		if (node.IsLeaf()) {
+			results.push_back(index);
+			continue;
+		}
+
+		assert(count + 2 <= BVH_STACK_SIZE);
+
+		stack[count++] = node.child1;
+		stack[count++] = node.child2;
+	}
+
+}
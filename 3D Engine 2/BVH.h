@@ -0,0 +1,86 @@
+#pragma once
+#include "Shapes.h"
+#include "Vec3.h"
+#include "Mat4.h"
+#include <vector>
+
+// how far a proxy's box is grown when it is inserted, objects can move
+// this far before their proxy needs to be reinserted into the tree
+#define BVH_MARGIN 0.2f
+
+#define BVH_NULL -1
+
+// deepest traversal the query stacks support
+#define BVH_STACK_SIZE 256
+
+// Dynamic bounding volume hierarchy over the objects in a scene.
+// Leaves are "proxies" with a fattened box and a user pointer.
+// Moving a proxy only touches the tree when it leaves its fat box, and
+// the tree is kept balanced with rotations as leaves are inserted and removed.
+// Based on the dynamic tree in Box2D, by Erin Catto.
+class BVH
+{
+
+private:
+
+	struct Node {
+
+		AABB box;
+		void* userData;
+
+		// parent when in the tree, next free node when on the free list
+		int parent;
+
+		int child1;
+		int child2;
+
+		// leaves have height 0, free nodes have height -1
+		int height;
+
+		bool IsLeaf() const {
+			return child1 == BVH_NULL;
+		}
+
+	};
+
+	std::vector<Node> nodes;
+
+	int root = BVH_NULL;
+	int freeList = BVH_NULL;
+
+	int numProxies = 0;
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+
+	int Balance(int node);
+
+public:
+
+	BVH();
+
+	int Insert(const AABB& box, void* userData);
+	void Remove(int proxy);
+
+	// returns true if the proxy had to be reinserted
+	bool Move(int proxy, const AABB& box);
+
+	void* GetUserData(int proxy) const;
+	const AABB& GetFatBox(int proxy) const;
+
+	int NumProxies() const;
+	int GetHeight() const;
+
+	// proxies with a box touching the inside of the view frustum
+	void QueryFrustum(const Mat4& viewProjection, std::vector<int>& results) const;
+
+	// proxies with a box hit by the ray, sorted nearest first
+	void QueryRay(const Vec3& origin, const Vec3& direction, float maxDistance, std::vector<int>& results) const;
+
+	// proxies with a box overlapping the sphere
+	void QuerySphere(const Vec3& center, float radius, std::vector<int>& results) const;
+
+};
@@ -0,0 +1,734 @@
+#include "Benchmark.h"
+#include "Manager.h"
+#include "Renderer.h"
+#include "Mat4.h"
+#include "Shapes.h"
+#include "Light.h"
+#include "Cow.h"
+#include "Cubemap.h"
+#include "AssetStreamer.h"
+#include "PostProcessChain.h"
+#include "Utility.h"
+#include <SDL.h>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <math.h>
+
+// overlapping full screen quads drawn back to front, every pixel passes the depth test
+#define FILL_LAYERS 8
+
+// a sphere this finely divided covers only a couple of pixels per triangle
+#define SMALL_TRIANGLE_RESOLUTION 200
+
+#define CHECKER_SIZE 1024
+#define CHECKER_CELL 16
+
+// the ground is far bigger than the far plane, so it is clipped every frame
+#define GROUND_SIZE 40
+#define GROUND_REPEAT 16
+
+// radians per second the orbiting cameras move
+#define ORBIT_SPEED 0.5f
+
+// operators are timed over arrays this long, so their operands stay in cache
+#define MICRO_OPERANDS 1024
+#define MICRO_REPEATS 1000
+
+class ColorVertex {
+
+public:
+	Vec4 position;
+	Vec4 color;
+
+	ColorVertex() {}
+	ColorVertex(const Vec4& position, const Vec4& color) : position(position), color(color) {}
+
+};
+
+class ColorPixel : public Renderer::PixelShaderInput {
+
+public:
+	Vec4 position;
+	Vec4 color;
+
+	ColorPixel() {}
+	ColorPixel(const Vec4& position, const Vec4& color) : position(position), color(color) {}
+
+	Vec4& GetPos() override {
+		return position;
+	}
+
+};
+
+class TexturedVertex {
+
+public:
+	Vec4 position;
+	Vec2 texel;
+
+	TexturedVertex() {}
+	TexturedVertex(const Vec4& position, const Vec2& texel) : position(position), texel(texel) {}
+
+};
+
+class TexturedPixel : public Renderer::PixelShaderInput {
+
+public:
+	Vec4 position;
+	Vec2 texel;
+
+	float padding[2];
+
+	TexturedPixel() {}
+	TexturedPixel(const Vec4& position, const Vec2& texel) : position(position), texel(texel) {}
+
+	Vec4& GetPos() override {
+		return position;
+	}
+
+};
+
+class NormalPixel : public Renderer::PixelShaderInput {
+
+public:
+	Vec4 position;
+	Vec3 normal;
+
+	NormalPixel() {}
+	NormalPixel(const Vec4& position, const Vec3& normal) : position(position), normal(normal) {}
+
+	Vec4& GetPos() override {
+		return position;
+	}
+
+};
+
+struct Scene {
+
+	const char* name;
+	short renderFlags;
+
+	// loads whatever the scene draws, returns false if it could not be loaded
+	bool (*setup)();
+	void (*draw)(Renderer& renderer, float time);
+	PostProcess_T postProcessing;
+	void (*teardown)();
+
+};
+
+struct Result {
+
+	const Scene* scene;
+	bool skipped = false;
+
+	// milliseconds, sorted
+	std::vector<double> frameTimes;
+
+	Renderer::PipelineStatistics statistics;
+
+};
+
+// the camera, shared by every scene
+static Frustum frustum;
+static Mat4 projection;
+static Mat4 view;
+static Vec3 cameraPos;
+
+// the scene being run, and how far into it the current frame is
+static const Scene* pScene = nullptr;
+static float sceneTime = 0;
+
+static Renderer::PipelineStatistics frameStatistics;
+static Renderer::PipelineStatistics totalStatistics;
+
+static std::vector<double> frameTimes;
+static Uint64 lastFrameEnd = 0;
+
+static void LookFrom(const Vec3& position, float pitch, float yaw)
+{
+	cameraPos = position;
+	view = (Mat4::Get3DTranslation(position.x, position.y, position.z) * Mat4::GetRotation(pitch, yaw, 0)).GetInverse();
+}
+
+// circles the origin, looking at it
+static void Orbit(float time, float radius, float height)
+{
+	float angle = time * ORBIT_SPEED;
+	LookFrom({ sinf(angle) * radius, height, cosf(angle) * radius }, -atanf(height / radius), angle);
+}
+
+// fill rate, and the post processing scene's background
+
+static ColorVertex fillVertices[FILL_LAYERS * 4];
+static int fillIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+static ColorPixel FillVertexShader(ColorVertex& vertex)
+{
+	// already in clip space
+	return ColorPixel(vertex.position, vertex.color);
+}
+
+static Vec4 FillPixelShader(ColorPixel& pixel, const Renderer::Sampler<ColorPixel>& sampler)
+{
+	return pixel.color;
+}
+
+static bool SetupFill()
+{
+	for ( int layer = 0; layer < FILL_LAYERS; ++layer ) {
+
+		// each layer is in front of the last
+		float z = 0.9f - 1.8f * layer / (FILL_LAYERS - 1);
+		float shade = (float)(layer + 1) / FILL_LAYERS;
+
+		ColorVertex* v = fillVertices + layer * 4;
+
+		v[0] = { { -1, -1, z, 1 }, { shade, 0, 1 - shade, 1 } };
+		v[1] = { { 1, -1, z, 1 }, { 0, shade, 1 - shade, 1 } };
+		v[2] = { { 1, 1, z, 1 }, { shade, shade, 0, 1 } };
+		v[3] = { { -1, 1, z, 1 }, { 1 - shade, 0, shade, 1 } };
+	}
+
+	return true;
+}
+
+static void DrawFill(Renderer& renderer, float time)
+{
+	// one draw per layer, so they are rasterized in the same order every run
+	for ( int layer = 0; layer < FILL_LAYERS; ++layer )
+		renderer.DrawElementArray<ColorVertex, ColorPixel>(2, fillIndices, fillVertices + layer * 4, FillVertexShader, FillPixelShader);
+}
+
+static void TeardownNothing() {}
+
+// many small triangles
+
+static Sphere* pSphere = nullptr;
+
+static NormalPixel SphereVertexShader(Vec4& vertex)
+{
+	return NormalPixel(projection * view * vertex, vertex.Vec3() / pSphere->radius);
+}
+
+static Vec4 SpherePixelShader(NormalPixel& pixel, const Renderer::Sampler<NormalPixel>& sampler)
+{
+	return (pixel.normal * 0.5f + Vec3(0.5f, 0.5f, 0.5f)).Vec4();
+}
+
+static bool SetupSphere()
+{
+	pSphere = new Sphere(SMALL_TRIANGLE_RESOLUTION, 3);
+	return true;
+}
+
+static void DrawSphere(Renderer& renderer, float time)
+{
+	Orbit(time, 8, 2);
+	renderer.DrawElementArray<Vec4, NormalPixel>(pSphere->nTriangles, pSphere->pIndices, pSphere->pVertices, SphereVertexShader, SpherePixelShader);
+}
+
+static void TeardownSphere()
+{
+	delete pSphere;
+	pSphere = nullptr;
+}
+
+// the cow, with its shadow pass
+
+static AssetStreamer* pStreamer = nullptr;
+static Cow* pCow = nullptr;
+static SpotLight* pLight = nullptr;
+
+static bool SetupCow()
+{
+	pStreamer = new AssetStreamer();
+	pCow = new Cow({ 0, 0, 0 }, { 0, PI / 4, 0 }, { 1, 1, 1 });
+	pLight = new SpotLight({ 1, 1, 1 }, { 0, 0, 10 }, { 0, 0, 0 }, 1.0f, 0.0f, 0.0f, 6, 2048, 2048);
+
+	pCow->Stream(*pStreamer);
+
+	// wait for the final model, not a coarse version published on the way,
+	// so every run draws the same triangles
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	while ( !pCow->IsLoaded() ) {
+
+		if ( (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency() > BENCHMARK_LOAD_TIMEOUT )
+			return false;
+
+		pStreamer->ReleaseFrame(pStreamer->EndFrame());
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	return true;
+}
+
+static void DrawCow(Renderer& renderer, float time)
+{
+	Orbit(time, 6, 3);
+
+	pLight->UpdateShadowBox(frustum, view.GetInverse());
+	pCow->UpdateLOD(projection, view, BENCHMARK_HEIGHT);
+
+	// the shadow pass draws with the light's renderer, so it is timed but not counted
+	pLight->BeginShadowPass(renderer);
+	pCow->AddToShadowMap(*pLight);
+	pLight->EndShadowPass();
+
+	pCow->Render(renderer, projection, view, *pLight, cameraPos);
+
+	long long frame = pStreamer->EndFrame();
+	renderer.RunInOrder([frame](Renderer&) { pStreamer->ReleaseFrame(frame); });
+}
+
+static void TeardownCow()
+{
+	delete pCow;
+	delete pLight;
+	delete pStreamer;
+
+	pCow = nullptr;
+	pLight = nullptr;
+	pStreamer = nullptr;
+}
+
+// texture sampling, the same ground plane in each filtering mode
+
+static Surface* pChecker = nullptr;
+
+static TexturedVertex groundVertices[4] = {
+	{ { -GROUND_SIZE, 0, -GROUND_SIZE, 1 }, { 0, 0 } },
+	{ { GROUND_SIZE, 0, -GROUND_SIZE, 1 }, { GROUND_REPEAT, 0 } },
+	{ { GROUND_SIZE, 0, GROUND_SIZE, 1 }, { GROUND_REPEAT, GROUND_REPEAT } },
+	{ { -GROUND_SIZE, 0, GROUND_SIZE, 1 }, { 0, GROUND_REPEAT } }
+};
+static int groundIndices[6] = { 3, 2, 1, 3, 1, 0 };
+
+static TexturedPixel GroundVertexShader(TexturedVertex& vertex)
+{
+	return TexturedPixel(projection * view * vertex.position, vertex.texel);
+}
+
+static Vec4 GroundPixelShader(TexturedPixel& pixel, const Renderer::Sampler<TexturedPixel>& sampler)
+{
+	return sampler.SampleTex2D(*pChecker, FLOAT_OFFSET(pixel, texel));
+}
+
+static bool SetupTexture()
+{
+	pChecker = new Surface(CHECKER_SIZE, CHECKER_SIZE);
+
+	for ( int y = 0; y < CHECKER_SIZE; ++y )
+		for ( int x = 0; x < CHECKER_SIZE; ++x )
+			pChecker->PutPixel(x, y, (x / CHECKER_CELL + y / CHECKER_CELL) % 2 ? Vec4(0.9f, 0.9f, 0.9f, 1) : Vec4(0.1f, 0.3f, 0.6f, 1));
+
+	pChecker->GenerateMipMaps();
+
+	return true;
+}
+
+static void DrawTexture(Renderer& renderer, float time)
+{
+	// low over the ground, moving forward and looking from side to side
+	LookFrom({ sinf(time) * 2, 2, 20 - time * 4 }, -0.25f, sinf(time * ORBIT_SPEED) * 0.5f);
+	renderer.DrawElementArray<TexturedVertex, TexturedPixel>(2, groundIndices, groundVertices, GroundVertexShader, GroundPixelShader);
+}
+
+static void TeardownTexture()
+{
+	delete pChecker;
+	pChecker = nullptr;
+}
+
+// cubemap
+
+static Cubemap* pCubemap = nullptr;
+
+static bool SetupCubemap()
+{
+	pCubemap = new Cubemap("cube/posx.jpg", "cube/negx.jpg", "cube/posy.jpg", "cube/negy.jpg", "cube/posz.jpg", "cube/negz.jpg");
+	return true;
+}
+
+static void DrawCubemap(Renderer& renderer, float time)
+{
+	Mat4 rotation = Mat4::GetRotation(sinf(time) * 0.3f, time * ORBIT_SPEED, 0);
+	pCubemap->Render(renderer, rotation.GetInverse(), projection);
+}
+
+static void TeardownCubemap()
+{
+	delete pCubemap;
+	pCubemap = nullptr;
+}
+
+// post processing, over a single cheap layer
+
+static PostProcessChain* pChain = nullptr;
+
+static bool SetupPostProcess()
+{
+	SetupFill();
+
+	pChain = new PostProcessChain();
+	pChain->Saturation(0.6f).Contrast(0.2f).ToneMap(1.5f, 4);
+
+	return true;
+}
+
+static void DrawPostProcess(Renderer& renderer, float time)
+{
+	renderer.DrawElementArray<ColorVertex, ColorPixel>(2, fillIndices, fillVertices, FillVertexShader, FillPixelShader);
+}
+
+static bool PostProcessScene(Surface& frame)
+{
+	pChain->Apply(frame);
+	frame.GaussianBlur(9, 3, Surface::BLUR_BOTH);
+
+	return false;
+}
+
+static void TeardownPostProcess()
+{
+	delete pChain;
+	pChain = nullptr;
+}
+
+// math microbenchmarks, each times one operator over the operand arrays
+
+struct Microbenchmark {
+
+	const char* name;
+
+	// nanoseconds per operation
+	double (*run)();
+
+};
+
+// one extra, so binary operators can use i and i + 1
+static Vec4 vectors[MICRO_OPERANDS + 1];
+static Mat4 matrices[MICRO_OPERANDS + 1];
+static float scalars[MICRO_OPERANDS];
+
+// an HDR target and a half float target, like screen space velocities, a pixel per operand
+static TypedSurface<RGBA32F> hdrTarget(MICRO_OPERANDS, 1);
+static TypedSurface<RG16F> velocityTarget(MICRO_OPERANDS, 1);
+
+static Vec4 vectorResults[MICRO_OPERANDS];
+static Mat4 matrixResults[MICRO_OPERANDS];
+static float scalarResults[MICRO_OPERANDS];
+
+// read after every run, so the results cannot be optimized away
+static volatile float microSink = 0;
+
+static float RandomFloat(float min, float max)
+{
+	return min + (max - min) * rand() / RAND_MAX;
+}
+
+static void SetupOperands()
+{
+	// the same operands every run
+	srand(1);
+
+	for ( int i = 0; i <= MICRO_OPERANDS; ++i ) {
+
+		vectors[i] = { RandomFloat(-10, 10), RandomFloat(-10, 10), RandomFloat(-10, 10), RandomFloat(0.5f, 2) };
+
+		// invertible, like the model and view matrices the renderer uses
+		matrices[i] = Mat4::Get3DTranslation(RandomFloat(-10, 10), RandomFloat(-10, 10), RandomFloat(-10, 10))
+			* Mat4::GetRotation(RandomFloat(-PI, PI), RandomFloat(-PI, PI), RandomFloat(-PI, PI))
+			* Mat4::GetScale(RandomFloat(0.5f, 2), RandomFloat(0.5f, 2), RandomFloat(0.5f, 2));
+	}
+
+	for ( int i = 0; i < MICRO_OPERANDS; ++i )
+		scalars[i] = RandomFloat(0.5f, 2);
+
+	for ( int i = 0; i < MICRO_OPERANDS; ++i )
+		hdrTarget.PutPixel(i, 0, vectors[i] * scalars[i]);
+}
+
+template <class Result, class Operation>
+static double TimeOperation(Result* results, Operation operation)
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	for ( int r = 0; r < MICRO_REPEATS; ++r )
+		for ( int i = 0; i < MICRO_OPERANDS; ++i )
+			results[i] = operation(i);
+
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	microSink = microSink + *(const float*)&results[MICRO_OPERANDS - 1];
+
+	return (end - start) * 1e9 / SDL_GetPerformanceFrequency() / ((double)MICRO_REPEATS * MICRO_OPERANDS);
+}
+
+#define VECTOR_BENCHMARK(NAME, EXPRESSION) { NAME, [] { return TimeOperation(vectorResults, [](int i) -> Vec4 { EXPRESSION; }); } }
+#define MATRIX_BENCHMARK(NAME, EXPRESSION) { NAME, [] { return TimeOperation(matrixResults, [](int i) -> Mat4 { EXPRESSION; }); } }
+#define SCALAR_BENCHMARK(NAME, EXPRESSION) { NAME, [] { return TimeOperation(scalarResults, [](int i) -> float { EXPRESSION; }); } }
+
+static double TimeTransformPoints()
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	for ( int r = 0; r < MICRO_REPEATS; ++r )
+		TransformPoints(matrices[r % MICRO_OPERANDS], vectors, vectorResults, MICRO_OPERANDS);
+
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	microSink = microSink + vectorResults[MICRO_OPERANDS - 1].x;
+
+	return (end - start) * 1e9 / SDL_GetPerformanceFrequency() / ((double)MICRO_REPEATS * MICRO_OPERANDS);
+}
+
+static const Microbenchmark MICROBENCHMARKS[] = {
+	VECTOR_BENCHMARK("vec4_assign", Vec4 v; v = vectors[i]; return v),
+	VECTOR_BENCHMARK("vec4_add", return vectors[i] + vectors[i + 1]),
+	VECTOR_BENCHMARK("vec4_subtract", return vectors[i] - vectors[i + 1]),
+	VECTOR_BENCHMARK("vec4_scale", return vectors[i] * scalars[i]),
+	VECTOR_BENCHMARK("vec4_divide", return vectors[i] / scalars[i]),
+	VECTOR_BENCHMARK("vec4_add_assign", Vec4 v = vectors[i]; v += vectors[i + 1]; return v),
+	VECTOR_BENCHMARK("vec4_subtract_assign", Vec4 v = vectors[i]; v -= vectors[i + 1]; return v),
+	VECTOR_BENCHMARK("vec4_scale_assign", Vec4 v = vectors[i]; v *= scalars[i]; return v),
+	VECTOR_BENCHMARK("vec4_divide_assign", Vec4 v = vectors[i]; v /= scalars[i]; return v),
+	VECTOR_BENCHMARK("vec4_negate", return -vectors[i]),
+	VECTOR_BENCHMARK("vec4_cross", return vectors[i] % vectors[i + 1]),
+	SCALAR_BENCHMARK("vec4_dot", return vectors[i] * vectors[i + 1]),
+	SCALAR_BENCHMARK("vec4_length", return vectors[i].Length()),
+	VECTOR_BENCHMARK("vec4_normalize", return vectors[i].Normalized()),
+	VECTOR_BENCHMARK("vec4_reflect", return vectors[i].Reflect(vectors[i + 1])),
+	VECTOR_BENCHMARK("vec4_refract", return vectors[i].Refract(vectors[i + 1], 1, 1.33f)),
+	VECTOR_BENCHMARK("vec4_modulate", return Vec4::Modulate(vectors[i], vectors[i + 1])),
+	VECTOR_BENCHMARK("vec4_clamp", Vec4 v = vectors[i]; v.Clamp(); return v),
+	MATRIX_BENCHMARK("mat4_assign", Mat4 m; m = matrices[i]; return m),
+	MATRIX_BENCHMARK("mat4_multiply", return matrices[i] * matrices[i + 1]),
+	VECTOR_BENCHMARK("mat4_transform", return matrices[i] * vectors[i]),
+	MATRIX_BENCHMARK("mat4_scale", return matrices[i] * scalars[i]),
+	SCALAR_BENCHMARK("mat4_determinant", return matrices[i].GetDeterminant()),
+	MATRIX_BENCHMARK("mat4_inverse", return matrices[i].GetInverse()),
+	MATRIX_BENCHMARK("mat4_transpose", return matrices[i].GetTranspose()),
+	MATRIX_BENCHMARK("mat4_rotation", return Mat4::GetRotation(scalars[i], scalars[i], scalars[i])),
+	// per point, compare with mat4_transform
+	{ "mat4_transform_points", TimeTransformPoints },
+	// per pixel, reading an HDR pixel and tonemapping it, and a round trip through half floats
+	VECTOR_BENCHMARK("rgba32f_tonemap", Vec4 c = hdrTarget.GetPixel(i, 0); return c / (1 + c.Length())),
+	VECTOR_BENCHMARK("rg16f_put_get", velocityTarget.PutPixel(i, 0, vectors[i]); return velocityTarget.GetPixel(i, 0))
+};
+
+static const Scene SCENES[] = {
+	{ "fill_rate", 0, SetupFill, DrawFill, nullptr, TeardownNothing },
+	{ "small_triangles", RF_BACKFACE_CULL, SetupSphere, DrawSphere, nullptr, TeardownSphere },
+	{ "cow_shadows", RF_BACKFACE_CULL, SetupCow, DrawCow, nullptr, TeardownCow },
+	{ "texture_point", 0, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "texture_bilinear", RF_BILINEAR, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "texture_mipmap", RF_MIPMAP, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "texture_mipmap_bilinear", RF_MIPMAP | RF_BILINEAR, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "texture_trilinear", RF_MIPMAP | RF_TRILINEAR, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "texture_trilinear_bilinear", RF_MIPMAP | RF_TRILINEAR | RF_BILINEAR, SetupTexture, DrawTexture, nullptr, TeardownTexture },
+	{ "cubemap", RF_BILINEAR, SetupCubemap, DrawCubemap, nullptr, TeardownCubemap },
+	{ "post_processing", 0, SetupPostProcess, DrawPostProcess, PostProcessScene, TeardownPostProcess }
+};
+
+static bool SceneLogic(Renderer& renderer, float deltaTime)
+{
+	pScene->draw(renderer, sceneTime);
+
+	// the headless loop resets the statistics at the start of every frame
+	frameStatistics = renderer.GetStatistics();
+
+	sceneTime += deltaTime;
+
+	return false;
+}
+
+static bool RecordFrame(const Surface& frame, int frameNumber)
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+
+	if ( frameNumber >= BENCHMARK_WARMUP_FRAMES ) {
+
+		frameTimes.push_back((now - lastFrameEnd) * 1000.0 / SDL_GetPerformanceFrequency());
+		totalStatistics += frameStatistics;
+	}
+
+	lastFrameEnd = now;
+
+	return false;
+}
+
+// nearest rank, times must be sorted
+static double Percentile(const std::vector<double>& times, double percent)
+{
+	int rank = (int)ceil(percent / 100 * times.size()) - 1;
+	return times[std::min(std::max(rank, 0), (int)times.size() - 1)];
+}
+
+static void WriteStatistics(std::ostream& out, const Renderer::PipelineStatistics& s, int frames)
+{
+	const std::pair<const char*, long long> counters[] = {
+		{ "vertexShaderInvocations", s.vertexShaderInvocations },
+		{ "trianglesSubmitted", s.trianglesSubmitted },
+		{ "trianglesOutside", s.trianglesOutside },
+		{ "trianglesClipped", s.trianglesClipped },
+		{ "clipperTriangles", s.clipperTriangles },
+		{ "trianglesCulled", s.trianglesCulled },
+		{ "trianglesRasterized", s.trianglesRasterized },
+		{ "depthTests", s.depthTests },
+		{ "depthPasses", s.depthPasses },
+		{ "pixelShaderInvocations", s.pixelShaderInvocations }
+	};
+
+	out << "{";
+
+	for ( int i = 0; i < (int)(sizeof(counters) / sizeof(counters[0])); ++i )
+		out << (i > 0 ? ", " : " ") << "\"" << counters[i].first << "\": " << (double)counters[i].second / frames;
+
+	out << " }";
+}
+
+static bool WriteResults(const std::string& filename, const std::vector<std::pair<const char*, double>>& microResults, const std::vector<Result>& results, int frames)
+{
+	std::ofstream file(filename);
+
+	if ( !file )
+		return false;
+
+	file << std::fixed << std::setprecision(3);
+
+	file << "{\n";
+	file << "\t\"width\": " << BENCHMARK_WIDTH << ",\n";
+	file << "\t\"height\": " << BENCHMARK_HEIGHT << ",\n";
+	file << "\t\"frames\": " << frames << ",\n";
+	file << "\t\"warmupFrames\": " << BENCHMARK_WARMUP_FRAMES << ",\n";
+	file << "\t\"threads\": " << (int)NUM_THREADS << ",\n";
+
+	file << "\t\"microbenchmarks\": [\n";
+
+	for ( int i = 0; i < (int)microResults.size(); ++i )
+		file << "\t\t{ \"name\": \"" << microResults[i].first << "\", \"nsPerOperation\": " << microResults[i].second << " }"
+			<< (i + 1 < (int)microResults.size() ? ",\n" : "\n");
+
+	file << "\t],\n";
+	file << "\t\"scenes\": [\n";
+
+	for ( int i = 0; i < (int)results.size(); ++i ) {
+
+		const Result& r = results[i];
+
+		file << "\t\t{ \"name\": \"" << r.scene->name << "\", \"renderFlags\": " << r.scene->renderFlags;
+
+		if ( r.skipped || r.frameTimes.empty() ) {
+			file << ", \"skipped\": true }";
+		}
+		else {
+
+			double total = 0;
+			for ( double t : r.frameTimes )
+				total += t;
+
+			int n = (int)r.frameTimes.size();
+
+			file << ", \"fps\": " << n * 1000 / total;
+			file << ", \"frameTimeMs\": { \"mean\": " << total / n
+				<< ", \"min\": " << r.frameTimes.front()
+				<< ", \"p50\": " << Percentile(r.frameTimes, 50)
+				<< ", \"p90\": " << Percentile(r.frameTimes, 90)
+				<< ", \"p99\": " << Percentile(r.frameTimes, 99)
+				<< ", \"max\": " << r.frameTimes.back() << " }";
+
+			file << ", \"statisticsPerFrame\": ";
+			WriteStatistics(file, r.statistics, n);
+
+			file << " }";
+		}
+
+		file << (i + 1 < (int)results.size() ? ",\n" : "\n");
+	}
+
+	file << "\t]\n";
+	file << "}\n";
+
+	return (bool)file;
+}
+
+int Benchmark::Run(const std::string& outputFile, const std::string& filter, int frames)
+{
+	projection = Mat4::GetPerspectiveProjection(1, 75, (float)BENCHMARK_HEIGHT / BENCHMARK_WIDTH, 90, frustum);
+
+	std::vector<std::pair<const char*, double>> microResults;
+
+	SetupOperands();
+
+	for ( const Microbenchmark& micro : MICROBENCHMARKS ) {
+
+		if ( !filter.empty() && std::string(micro.name).find(filter) == std::string::npos )
+			continue;
+
+		microResults.push_back({ micro.name, micro.run() });
+
+		std::cout << micro.name << ": " << microResults.back().second << " ns" << std::endl;
+	}
+
+	std::vector<Result> results;
+	int failed = 0;
+
+	for ( const Scene& scene : SCENES ) {
+
+		if ( !filter.empty() && std::string(scene.name).find(filter) == std::string::npos )
+			continue;
+
+		Result result;
+		result.scene = &scene;
+
+		std::cout << "Benchmark: " << scene.name << std::endl;
+
+		if ( !scene.setup() ) {
+
+			std::cout << "Could not load " << scene.name << ", skipping it" << std::endl;
+
+			result.skipped = true;
+			++failed;
+		}
+		else {
+
+			pScene = &scene;
+			sceneTime = 0;
+
+			frameTimes.clear();
+			frameTimes.reserve(frames);
+			totalStatistics = Renderer::PipelineStatistics();
+
+			lastFrameEnd = SDL_GetPerformanceCounter();
+
+			StartHeadlessInstance(BENCHMARK_WIDTH, BENCHMARK_HEIGHT, SceneLogic, scene.postProcessing, RecordFrame,
+				scene.renderFlags, frames + BENCHMARK_WARMUP_FRAMES, BENCHMARK_DELTA_TIME);
+
+			std::sort(frameTimes.begin(), frameTimes.end());
+
+			result.frameTimes = frameTimes;
+			result.statistics = totalStatistics;
+
+			if ( !frameTimes.empty() )
+				std::cout << scene.name << ": p50 " << Percentile(frameTimes, 50) << " ms, p99 " << Percentile(frameTimes, 99) << " ms" << std::endl;
+		}
+
+		scene.teardown();
+		results.push_back(result);
+	}
+
+	if ( !WriteResults(outputFile, microResults, results, frames) ) {
+		std::cout << "Could not write " << outputFile << std::endl;
+		return failed + 1;
+	}
+
+	std::cout << "Benchmark results written to " << outputFile << std::endl;
+
+	return failed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+#define BENCHMARK_WIDTH 1280
+#define BENCHMARK_HEIGHT 720
+
+#define BENCHMARK_FRAMES 120
+// the first frames fill caches and are left out of the results
+#define BENCHMARK_WARMUP_FRAMES 10
+
+// every frame advances the scenes by the same amount, however long it took
+#define BENCHMARK_DELTA_TIME (1 / 60.0f)
+
+// how long to wait for streamed assets before giving up on a scene, in seconds
+#define BENCHMARK_LOAD_TIMEOUT 60
+
+#define BENCHMARK_RESULTS_FILE "benchmark.json"
+
+// Renders a fixed set of scenes offscreen, each with a fixed camera path and
+// frame time, so two runs on the same machine draw exactly the same frames.
+// For each scene it reports frames per second, percentile frame times and the
+// renderer's pipeline statistics averaged per frame. Before the scenes, every
+// Vec4 and Mat4 operator is timed on its own. Everything is written out as
+// JSON so results can be compared between versions.
+// The tree is still only built with MSVC through the Visual Studio project,
+// so it does not run on Linux servers or CI until it has a build there.
+namespace Benchmark {
+
+	// runs every scene and microbenchmark with filter in its name, all of them
+	// if filter is empty. returns the number of scenes that could not be run
+	int Run(const std::string& outputFile, const std::string& filter = "", int frames = BENCHMARK_FRAMES);
+
+}
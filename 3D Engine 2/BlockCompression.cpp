@@ -0,0 +1,335 @@
+#include "BlockCompression.h"
+#include "Surface.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define CHANNEL(p, c) (((p) >> (8 * (c))) & 0xff)
+
+static unsigned short Pack565(int r, int g, int b) {
+	return (unsigned short)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void Unpack565(unsigned short c, int& r, int& g, int& b) {
+
+	// replicate the high bits into the low ones so 31 maps to 255
+	r = (c >> 11) & 31;
+	g = (c >> 5) & 63;
+	b = c & 31;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+}
+
+static void ColorPalette(unsigned short c0, unsigned short c1, int palette[4][3], bool& threeColor) {
+
+	Unpack565(c0, palette[0][0], palette[0][1], palette[0][2]);
+	Unpack565(c1, palette[1][0], palette[1][1], palette[1][2]);
+
+	threeColor = c0 <= c1;
+
+	for (int c = 0; c < 3; ++c) {
+
+		if (threeColor) {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		else {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+}
+
+// 8 bytes, two 565 endpoints and a 2 bit index per pixel
+static void EncodeColor(const int pixels[16], unsigned char* block) {
+
+	// endpoints at the extremes of the colors along their principal axis,
+	// found with a few rounds of power iteration on the covariance matrix
+	float mean[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 3; ++c)
+			mean[c] += CHANNEL(pixels[i], c) / 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+
+	for (int i = 0; i < 16; ++i) {
+
+		float r = CHANNEL(pixels[i], 0) - mean[0];
+		float g = CHANNEL(pixels[i], 1) - mean[1];
+		float b = CHANNEL(pixels[i], 2) - mean[2];
+
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b;
+		cov[5] += b * b;
+	}
+
+	float axis[3] = { 1, 1, 1 };
+
+	for (int iteration = 0; iteration < 8; ++iteration) {
+
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+		float length = fmaxf(fmaxf(fabsf(x), fabsf(y)), fabsf(z));
+
+		if (length == 0)
+			break;
+
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	float minProjection = 1e30f;
+	float maxProjection = -1e30f;
+
+	for (int i = 0; i < 16; ++i) {
+
+		float projection = 0;
+		for (int c = 0; c < 3; ++c)
+			projection += (CHANNEL(pixels[i], c) - mean[c]) * axis[c];
+
+		minProjection = fminf(minProjection, projection);
+		maxProjection = fmaxf(maxProjection, projection);
+	}
+
+	float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+	int min[3];
+	int max[3];
+
+	for (int c = 0; c < 3; ++c) {
+
+		float lo = mean[c] + axis[c] * minProjection / axisLength;
+		float hi = mean[c] + axis[c] * maxProjection / axisLength;
+
+		min[c] = (int)fminf(fmaxf(lo + 0.5f, 0), 255);
+		max[c] = (int)fminf(fmaxf(hi + 0.5f, 0), 255);
+	}
+
+	unsigned short c0 = Pack565(max[0], max[1], max[2]);
+	unsigned short c1 = Pack565(min[0], min[1], min[2]);
+
+	unsigned int indices = 0;
+
+	// a flat block, every pixel uses the first endpoint
+	if (c0 == c1) {
+
+		block[0] = c0 & 0xff; block[1] = c0 >> 8;
+		block[2] = c1 & 0xff; block[3] = c1 >> 8;
+		block[4] = block[5] = block[6] = block[7] = 0;
+		return;
+	}
+
+	// four color mode needs c0 > c1
+	if (c0 < c1) {
+		unsigned short temp = c0;
+		c0 = c1;
+		c1 = temp;
+	}
+
+	int palette[4][3];
+	bool threeColor;
+	ColorPalette(c0, c1, palette, threeColor);
+
+	for (int i = 0; i < 16; ++i) {
+
+		int best = 0;
+		int bestError = 1 << 30;
+
+		for (int p = 0; p < 4; ++p) {
+
+			int dr = CHANNEL(pixels[i], 0) - palette[p][0];
+			int dg = CHANNEL(pixels[i], 1) - palette[p][1];
+			int db = CHANNEL(pixels[i], 2) - palette[p][2];
+
+			int error = dr * dr + dg * dg + db * db;
+
+			if (error < bestError) {
+				bestError = error;
+				best = p;
+			}
+		}
+
+		indices |= best << (2 * i);
+	}
+
+	block[0] = c0 & 0xff; block[1] = c0 >> 8;
+	block[2] = c1 & 0xff; block[3] = c1 >> 8;
+	block[4] = indices & 0xff;
+	block[5] = (indices >> 8) & 0xff;
+	block[6] = (indices >> 16) & 0xff;
+	block[7] = indices >> 24;
+}
+
+static void DecodeColor(const unsigned char* block, int pixels[16], bool allowTransparent) {
+
+	unsigned short c0 = block[0] | block[1] << 8;
+	unsigned short c1 = block[2] | block[3] << 8;
+	unsigned int indices = block[4] | block[5] << 8 | block[6] << 16 | (unsigned int)block[7] << 24;
+
+	int palette[4][3];
+	bool threeColor;
+	ColorPalette(c0, c1, palette, threeColor);
+
+	for (int i = 0; i < 16; ++i) {
+
+		int p = (indices >> (2 * i)) & 3;
+
+		// the fourth entry of the three color mode is transparent black
+		int alpha = threeColor && p == 3 && allowTransparent ? 0 : 255;
+
+		pixels[i] = palette[p][0] | palette[p][1] << 8 | palette[p][2] << 16 | (unsigned int)alpha << 24;
+	}
+}
+
+static void SingleChannelPalette(int v0, int v1, int palette[8]) {
+
+	palette[0] = v0;
+	palette[1] = v1;
+
+	if (v0 > v1) {
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * v0 + i * v1) / 7;
+	}
+	else {
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * v0 + i * v1) / 5;
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// 8 bytes, two 8 bit endpoints and a 3 bit index per pixel, one channel of the pixels
+static void EncodeSingleChannel(const int pixels[16], int channel, unsigned char* block) {
+
+	int min = 255;
+	int max = 0;
+
+	for (int i = 0; i < 16; ++i) {
+
+		int v = CHANNEL(pixels[i], channel);
+
+		if (v < min) min = v;
+		if (v > max) max = v;
+	}
+
+	block[0] = max;
+	block[1] = min;
+
+	int palette[8];
+	SingleChannelPalette(max, min, palette);
+
+	unsigned long long indices = 0;
+
+	for (int i = 0; i < 16; ++i) {
+
+		int v = CHANNEL(pixels[i], channel);
+
+		int best = 0;
+		for (int p = 1; p < 8; ++p)
+			if (abs(v - palette[p]) < abs(v - palette[best]))
+				best = p;
+
+		indices |= (unsigned long long)best << (3 * i);
+	}
+
+	for (int b = 0; b < 6; ++b)
+		block[2 + b] = (indices >> (8 * b)) & 0xff;
+}
+
+static void DecodeSingleChannel(const unsigned char* block, int values[16]) {
+
+	int palette[8];
+	SingleChannelPalette(block[0], block[1], palette);
+
+	unsigned long long indices = 0;
+	for (int b = 0; b < 6; ++b)
+		indices |= (unsigned long long)block[2 + b] << (8 * b);
+
+	for (int i = 0; i < 16; ++i)
+		values[i] = palette[(indices >> (3 * i)) & 7];
+}
+
+int BlockCompression::BlockBytes(int format) {
+
+	switch (format) {
+	case SURFACE_BC1:
+		return 8;
+	case SURFACE_BC3:
+	case SURFACE_BC5:
+		return 16;
+	default:
+		return 0;
+	}
+
+}
+
+void BlockCompression::EncodeBlock(int format, const int pixels[16], unsigned char* block) {
+
+	switch (format) {
+
+	case SURFACE_BC1:
+		EncodeColor(pixels, block);
+		break;
+
+	case SURFACE_BC3:
+		EncodeSingleChannel(pixels, 3, block);
+		EncodeColor(pixels, block + 8);
+		break;
+
+	case SURFACE_BC5:
+		EncodeSingleChannel(pixels, 0, block);
+		EncodeSingleChannel(pixels, 1, block + 8);
+		break;
+	}
+
+}
+
+void BlockCompression::DecodeBlock(int format, const unsigned char* block, int pixels[16]) {
+
+	switch (format) {
+
+	case SURFACE_BC1:
+		DecodeColor(block, pixels, true);
+		break;
+
+	case SURFACE_BC3: {
+
+		int alpha[16];
+		DecodeSingleChannel(block, alpha);
+		DecodeColor(block + 8, pixels, false);
+
+		for (int i = 0; i < 16; ++i)
+			pixels[i] = (pixels[i] & 0x00ffffff) | (unsigned int)alpha[i] << 24;
+
+		break;
+	}
+
+	case SURFACE_BC5: {
+
+		int red[16];
+		int green[16];
+		DecodeSingleChannel(block, red);
+		DecodeSingleChannel(block + 8, green);
+
+		for (int i = 0; i < 16; ++i) {
+
+			// the channels are the x and y of a unit normal, z is rebuilt from them
+			float x = red[i] / 127.5f - 1;
+			float y = green[i] / 127.5f - 1;
+			float zz = 1 - x * x - y * y;
+			int blue = (int)((zz > 0 ? sqrtf(zz) : 0) * 127.5f + 127.5f);
+
+			pixels[i] = red[i] | green[i] << 8 | blue << 16 | 0xffu << 24;
+		}
+
+		break;
+	}
+	}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Encoding and decoding of single 4x4 blocks in the BC formats.
+// Pixels are 32 bit with red in the lowest byte and alpha in the highest,
+// the same as a Surface with the default color masks, stored in rows of 4.
+namespace BlockCompression {
+
+	// bytes one 4x4 block takes up, 0 for SURFACE_UNCOMPRESSED
+	int BlockBytes(int format);
+
+	void EncodeBlock(int format, const int pixels[16], unsigned char* block);
+	void DecodeBlock(int format, const unsigned char* block, int pixels[16]);
+
+}
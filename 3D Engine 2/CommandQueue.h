@@ -0,0 +1,197 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define COMMAND_QUEUE_CAPACITY 256
+
+// A queue any number of threads can add to while one thread takes from it.
+// Commands go into a ring of slots that each carry a sequence number, so
+// claiming a slot is a single compare and swap and nothing is allocated per
+// command. When the ring is full, commands spill into an overflow list under
+// a lock, which grows as needed. The commands from any one thread come out in
+// the order they went in. Commands from different threads have no order
+// between them, except that a batch always comes out together.
+template <typename T>
+class CommandQueue
+{
+private:
+
+	struct Slot {
+
+		// position + 1 once the slot holds the command for position,
+		// position + capacity once it has been taken and can be reused
+		std::atomic<size_t> sequence;
+		T value;
+
+	};
+
+	Slot* slots;
+	size_t mask;
+
+	// producers and the consumer write these constantly, so they get their own cache lines
+	alignas(64) std::atomic<size_t> enqueuePos;
+	alignas(64) size_t dequeuePos = 0;
+
+	// commands that did not fit in the ring, only taken once the ring is empty
+	std::mutex overflowMutex;
+	std::vector<T> overflow;
+	std::atomic<bool> overflowing;
+
+	// overflow the consumer has taken but not returned yet
+	std::vector<T> spilled;
+	size_t spilledIndex = 0;
+
+	// claims count slots in a row, or none if they are not all free
+	bool TryPush(const T* values, size_t count) {
+
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+		for (;;) {
+
+			// slots are freed in order, so if the last one is free they all are
+			Slot& last = slots[(pos + count - 1) & mask];
+			intptr_t difference = (intptr_t)last.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + count - 1);
+
+			if (difference == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+
+			Slot& slot = slots[(pos + i) & mask];
+
+			slot.value = values[i];
+			slot.sequence.store(pos + i + 1, std::memory_order_release);
+		}
+
+		return true;
+	}
+
+	bool TryPop(T& value) {
+
+		Slot& slot = slots[dequeuePos & mask];
+
+		// empty, or the next command is still being written
+		if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+			return false;
+
+		value = slot.value;
+		slot.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+		++dequeuePos;
+
+		return true;
+	}
+
+public:
+
+	// capacity is rounded up to a power of 2, and at least 2
+	CommandQueue(int capacity = COMMAND_QUEUE_CAPACITY)
+		:
+		enqueuePos(0), overflowing(false)
+	{
+		// with one slot, a filled slot's sequence equals the next position
+		// a producer looks for, so it would overwrite a pending command
+		size_t size = 2;
+		while (size < (size_t)capacity)
+			size *= 2;
+
+		slots = new Slot[size];
+		mask = size - 1;
+
+		for (size_t i = 0; i < size; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~CommandQueue() {
+		delete[] slots;
+	}
+
+	CommandQueue(const CommandQueue&) = delete;
+	CommandQueue& operator=(const CommandQueue&) = delete;
+
+	// can be called from any thread
+	void Enqueue(const T& value) {
+		EnqueueBatch(&value, 1);
+	}
+
+	// adds all count commands next to each other, can be called from any thread
+	void EnqueueBatch(const T* values, int count) {
+
+		if (count <= 0)
+			return;
+
+		// once anything has spilled, everything spills until the consumer catches up,
+		// otherwise a thread's later commands could pass its spilled ones
+		if (!overflowing.load(std::memory_order_acquire) && (size_t)count <= mask + 1 && TryPush(values, count))
+			return;
+
+		std::lock_guard<std::mutex> lock(overflowMutex);
+
+		overflowing.store(true, std::memory_order_release);
+		overflow.insert(overflow.end(), values, values + count);
+	}
+
+	// only the consuming thread can call this, returns false if there is nothing to take
+	bool TryDequeue(T& value) {
+
+		if (spilledIndex < spilled.size()) {
+			value = spilled[spilledIndex++];
+			return true;
+		}
+
+		if (TryPop(value))
+			return true;
+
+		// the ring has to be completely empty before the overflow is taken,
+		// a command still being written could belong to a thread that spilled after it
+		if (!overflowing.load(std::memory_order_acquire) || dequeuePos != enqueuePos.load(std::memory_order_acquire))
+			return false;
+
+		spilled.clear();
+		spilledIndex = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(overflowMutex);
+
+			spilled.swap(overflow);
+			overflowing.store(false, std::memory_order_release);
+		}
+
+		if (spilled.empty())
+			return false;
+
+		value = spilled[spilledIndex++];
+		return true;
+	}
+
+	// passes every command that is ready to body, in order, and returns how many there were
+	// only the consuming thread can call this
+	template <typename Body>
+	int Drain(const Body& body) {
+
+		int count = 0;
+
+		T value;
+		while (TryDequeue(value)) {
+			body(value);
+			++count;
+		}
+
+		return count;
+	}
+
+	// only exact on the consuming thread, while nothing is being added
+	bool IsEmpty() const {
+		return spilledIndex == spilled.size() && dequeuePos == enqueuePos.load(std::memory_order_acquire) && !overflowing.load(std::memory_order_acquire);
+	}
+
+};
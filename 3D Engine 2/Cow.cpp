@@ -1,64 +1,72 @@
 #include "Cow.h"
 #include "Mat3.h"
-#include "Importing.h"
+#include "MeshCache.h"
 #include "Utility.h"
 
-#define MODEL 0
-#define MVP 1
-#define NORM 2
-#define SHADOW 3
-
-#define CAMERA 0
-
 #define SHADOW_SAMPLE 5
 
 #define FILE "models/OBJ/Cow2.obj"
 
-const Cow* Cow::boundObject = nullptr;
-Mat4 Cow::boundMatrices[10];
-Vec3 Cow::boundVectors[5];
-const SpotLight* Cow::boundLight = nullptr;
+Vec4 Cow::FetchPosition(const CowVertex& vertex, const Model* pModel)
+{
+#ifdef COW_COMPACT_VERTICES
+	return pModel->quantizer.Decode(vertex.position);
+#else
+	return vertex.position;
+#endif
+}
 
-Cow::CowPixel Cow::MainVertexShader(CowVertex& vertex)
+Vec3 Cow::FetchNormal(const CowVertex& vertex)
 {
+#ifdef COW_COMPACT_VERTICES
+	return DecodeNormal(vertex.normal);
+#else
+	return vertex.normal;
+#endif
+}
+
+Cow::CowPixel Cow::MainVertexShader(CowVertex& vertex, const MainUniforms& uniforms)
+{
+	Vec4 position = FetchPosition(vertex, uniforms.pModel);
+
 	// homogeneous clip space position
-	Vec4 hcs = boundMatrices[MVP] * vertex.position;
+	Vec4 hcs = uniforms.mvp * position;
 
 	// rotate the surface normal
-	Vec3 norm = boundMatrices[NORM].Truncate() * vertex.normal;
+	Vec3 norm = uniforms.normalMatrix * FetchNormal(vertex);
 
 	CowPixel tp;
 	tp.position = hcs;
 	tp.normal = norm;
-	tp.worldPos = (boundMatrices[MODEL] * vertex.position).Vec3();
+	tp.worldPos = (uniforms.model * position).Vec3();
 
 	// the shadow map coordinate in viewport space
-	Vec4 s = Mat4::Viewport * boundMatrices[SHADOW] * boundMatrices[MODEL] * vertex.position;
+	Vec4 s = uniforms.modelToShadow * position;
 	tp.shadow = { s.s, s.t, s.p };
 
 	return tp;
 }
 
-Vec4 Cow::MainPixelShader(CowPixel& pixel, const Renderer::Sampler<CowPixel>& sampler)
+Vec4 Cow::MainPixelShader(CowPixel& pixel, const MainUniforms& uniforms, const Renderer::Sampler<CowPixel>& sampler)
 {
 	// fraction of the pixels that lie in shadow
-	float fracInShadow = boundLight->MultiSampleShadowMap(pixel.shadow, SHADOW_SAMPLE);
+	float fracInShadow = uniforms.pLight->MultiSampleShadowMap(pixel.shadow, SHADOW_SAMPLE);
 
 	// color of the light
-	Vec3 lightCol = boundLight->GetColorAt(pixel.worldPos);
+	Vec3 lightCol = uniforms.pLight->GetColorAt(pixel.worldPos);
 
 	// how much the surface faces the light
-	float facingFactor = Light::FacingFactor(boundLight->GetDirection(), pixel.normal.Normalized());
+	float facingFactor = Light::FacingFactor(uniforms.pLight->GetDirection(), pixel.normal.Normalized());
 
 	Vec3 normal = pixel.normal.Normalized();
-	Vec3 toCamera = (boundVectors[CAMERA] - pixel.worldPos).Normalized();
+	Vec3 toCamera = (uniforms.cameraPos - pixel.worldPos).Normalized();
 	
 	// spec factor is how much to scale the specular color by
-	float specFactor = Light::SpecularFactor((boundLight->GetPosition() - pixel.worldPos).Normalized(), normal, toCamera, 15);
+	float specFactor = Light::SpecularFactor((uniforms.pLight->GetPosition() - pixel.worldPos).Normalized(), normal, toCamera, 15);
 
 	// the colors based on the materials surface properties
 	// diffuse, specular (specular color will be the light color)
-	Vec3 nonLightCol = boundObject->diffuseColor * facingFactor + boundLight->GetColor() * specFactor;
+	Vec3 nonLightCol = uniforms.diffuseColor * facingFactor + uniforms.pLight->GetColor() * specFactor;
 
 	// final non ambient color is the color of the light modulated with
 	// the colors not contributed by the light
@@ -79,10 +87,10 @@ Vec4 Cow::MainPixelShader(CowPixel& pixel, const Renderer::Sampler<CowPixel>& sa
 	return finalColor.Vec4();
 }
 
-Cow::CowPixel Cow::ShadowVertexShader(CowVertex& vertex)
+Cow::CowPixel Cow::ShadowVertexShader(CowVertex& vertex, const ShadowUniforms& uniforms)
 {
 	// shadow coordinate in light space
-	Vec4 pos = boundMatrices[SHADOW] * boundMatrices[MODEL] * vertex.position;
+	Vec4 pos = uniforms.modelToLight * FetchPosition(vertex, uniforms.pModel);
 
 	CowPixel p;
 	p.position = pos;
@@ -90,7 +98,7 @@ Cow::CowPixel Cow::ShadowVertexShader(CowVertex& vertex)
 	return p;
 }
 
-Vec4 Cow::ShadowPixelShader(CowPixel& pixel, const Renderer::Sampler<CowPixel>& sampler)
+Vec4 Cow::ShadowPixelShader(CowPixel& pixel, const ShadowUniforms& uniforms, const Renderer::Sampler<CowPixel>& sampler)
 {
 	return { 0, 0, 0, 0 };
 }
@@ -99,91 +107,229 @@ Cow::Cow(const Vec3& position, const Vec3& rotation, const Vec3& scale)
 	:
 	position(position), rotation(rotation), scale(scale)
 {
-	Scene scene(FILE);
+}
+
+void Cow::Stream(AssetStreamer& streamer)
+{
+	this->streamer = &streamer;
+	modelHandle = streamer.Request(LoadModel);
+}
+
+bool Cow::IsLoaded() const
+{
+	return streamer != nullptr && streamer->IsLoaded(modelHandle);
+}
+
+StreamedAsset* Cow::LoadModel(const AssetStreamer::Publisher& publish)
+{
+	// imports the model the first time, afterwards maps the cache built from it
+	MeshCache cache;
+	if ( !cache.Load(FILE) || cache.NumMeshes() == 0 || cache.MeshAt(0).normals == nullptr ) {
+		std::cout << "Could not load " << FILE << std::endl;
+		return nullptr;
+	}
 
-	Mesh mesh = scene.MeshAt(0);
+	CachedMesh mesh = cache.MeshAt(0);
 
-	nTriangles = mesh.NumTriangles();
-	std::cout << mesh.NumVertices() << std::endl;
-	pIndices = new int[nTriangles * 3];
+	std::cout << mesh.numVertices << std::endl;
 
-	// read indices
-	for ( unsigned int i = 0; i < nTriangles * 3; ++i )
-		pIndices[i] = mesh.Indices(i);
+	// the coarsest level only needs a fraction of the vertices, show it while the rest is built
+	if ( mesh.numLevels > 1 )
+		publish(BuildModel(mesh, mesh.numLevels - 1));
+
+	return BuildModel(mesh, 0);
+}
+
+Cow::Model* Cow::BuildModel(const CachedMesh& mesh, int firstLevel)
+{
+	Model* model = new Model();
+
+	// first index of firstLevel, the levels are stored one after another
+	const int* levelIndices = mesh.indices;
+	for ( int level = 0; level < firstLevel; ++level )
+		levelIndices += mesh.levels[level].numTriangles * 3;
+
+	int numIndices = 0;
+	for ( int level = firstLevel; level < mesh.numLevels; ++level )
+		numIndices += mesh.levels[level].numTriangles * 3;
+
+	// number the vertices in the order the kept levels use them
+	std::vector<int> remap(mesh.numVertices, -1);
+	std::vector<int> used;
+
+	std::vector<int> indices(levelIndices, levelIndices + numIndices);
+	for ( int& index : indices ) {
+
+		if ( remap[index] == -1 ) {
+			remap[index] = (int)used.size();
+			used.push_back(index);
+		}
+
+		index = remap[index];
+	}
+
+	// level 0 holds the original indices
+	model->lods.Reset(mesh.center, mesh.radius);
+
+	const int* next = indices.data();
+	for ( int level = firstLevel; level < mesh.numLevels; ++level ) {
+
+		model->lods.AddLevel(next, mesh.levels[level].numTriangles, mesh.levels[level].error);
+		next += mesh.levels[level].numTriangles * 3;
+	}
+
+	// the bounds are needed before the positions can be quantized
+	model->localBounds = mesh.bounds;
+	model->quantizer = PositionQuantizer(model->localBounds);
 
 	// read vertices
-	pVertices = new CowVertex[mesh.NumVertices()];
-	for ( unsigned int i = 0; i < mesh.NumVertices(); ++i ) {
+	model->numVertices = (int)used.size();
+	model->pVertices = new CowVertex[model->numVertices];
+
+	for ( int i = 0; i < model->numVertices; ++i ) {
 
-		Vec4 pos = mesh.Positions(i).Vec4();
-		Vec3 norm = mesh.Normals(i);
+		const float* p = mesh.positions + used[i] * 3;
+		const float* n = mesh.normals + used[i] * 3;
 
-		pVertices[i] = { pos, norm};
+#ifdef COW_COMPACT_VERTICES
+		model->pVertices[i] = { model->quantizer.Encode({ p[0], p[1], p[2] }), EncodeNormal({ n[0], n[1], n[2] }) };
+#else
+		Vec4 pos = { p[0], p[1], p[2], 1 };
+		Vec3 norm = { n[0], n[1], n[2] };
+
+		model->pVertices[i] = { pos, norm};
+#endif
 	}
+
+	// halve the index buffers when every vertex fits in 16 bits
+	if ( FitsShortIndices(model->numVertices) ) {
+
+		model->shortIndices.resize(model->lods.NumLevels());
+
+		for ( int level = 0; level < model->lods.NumLevels(); ++level )
+			NarrowIndices(model->lods.GetIndices(level), model->lods.NumTriangles(level) * 3, model->shortIndices[level]);
+
+		// only one width of indices is kept
+		model->lods.DropIndices();
+	}
+
+	return model;
 }
 
-Cow::~Cow()
+Cow::Model::~Model()
 {
-	delete[] pIndices;
 	delete[] pVertices;
 }
 
-void Cow::AddToShadowMap(SpotLight& light)
+size_t Cow::Model::GetMemoryUsage() const
 {
-	boundObject = this;
-	boundLight = &light;
+	size_t bytes = numVertices * sizeof(CowVertex);
+
+	for ( int level = 0; level < lods.NumLevels(); ++level )
+		bytes += lods.NumTriangles(level) * 3 * (shortIndices.empty() ? sizeof(int) : sizeof(unsigned short));
 
-	// bind the model matrix
-	boundMatrices[MODEL] = Mat4::Get3DTranslation(position.x, position.y, position.z) *
+	return bytes;
+}
+
+Mat4 Cow::GetModelMatrix() const
+{
+	return Mat4::Get3DTranslation(position.x, position.y, position.z) *
 		Mat4::GetRotation(rotation.x, rotation.y, rotation.z) *
 		Mat4::GetScale(scale.x, scale.y, scale.z);
+}
 
-	// bind the world to shadow space matrix
-	boundMatrices[SHADOW] = light.WorldToShadowMatrix();
+AABB Cow::GetBoundingBox() const
+{
+	// nothing to bound until the model arrives
+	if ( model == nullptr )
+		return { position, position };
+
+	// world space bounds of the cow with its current transform
+	return model->localBounds.Transformed(GetModelMatrix());
+}
+
+void Cow::UpdateLOD(const Mat4& proj, const Mat4& view, int viewportHeight)
+{
+	model = streamer != nullptr ? streamer->Get<Model>(modelHandle) : nullptr;
 
-	light.DrawToShadowMap<CowVertex, CowPixel>(nTriangles, pIndices, pVertices, ShadowVertexShader, ShadowPixelShader);
+	if ( model == nullptr )
+		return;
 
-	boundObject = nullptr;
-	boundLight = nullptr;
+	currentLOD = model->lods.SelectLevel(view * GetModelMatrix(), proj(1, 1), viewportHeight, maxPixelError);
+}
+
+int Cow::GetLOD() const
+{
+	return currentLOD;
+}
+
+void Cow::AddToShadowMap(SpotLight& light)
+{
+	// the model has not loaded yet
+	if ( model == nullptr )
+		return;
+
+	ShadowUniforms uniforms;
+
+	// object space straight to the light's space
+	uniforms.modelToLight = light.WorldToShadowMatrix() * GetModelMatrix();
+	uniforms.pModel = model;
+
+	const LODChain& lods = model->lods;
+
+	if ( !model->shortIndices.empty() )
+		light.DrawToShadowMap<CowVertex, CowPixel>(lods.NumTriangles(currentLOD), model->shortIndices[currentLOD].data(), model->pVertices, uniforms, ShadowVertexShader, ShadowPixelShader);
+	else
+		light.DrawToShadowMap<CowVertex, CowPixel>(lods.NumTriangles(currentLOD), lods.GetIndices(currentLOD), model->pVertices, uniforms, ShadowVertexShader, ShadowPixelShader);
 }
 
 void Cow::Render(Renderer& renderer, const Mat4& proj, const Mat4& view, const SpotLight& light, const Vec3& cameraPos)
 {
-	boundObject = this;
-	boundLight = &light;
+	// the model has not loaded yet
+	if ( model == nullptr )
+		return;
 
-	// bind the model matrix
-	boundMatrices[MODEL] = Mat4::Get3DTranslation(position.x, position.y, position.z) *
-		Mat4::GetRotation(rotation.x, rotation.y, rotation.z) *
-		Mat4::GetScale(scale.x, scale.y, scale.z);
+	MainUniforms uniforms;
 
-	// bind the model view projection matrix
-	boundMatrices[MVP] = proj * view * boundMatrices[MODEL];
+	uniforms.model = GetModelMatrix();
+	uniforms.mvp = proj * view * uniforms.model;
 
-	// bind the matrix to transform normals
-	boundMatrices[NORM] = Mat4::GetRotation(rotation.x, rotation.y, rotation.z);
+	// object space to the shadow map's viewport in one matrix
+	uniforms.modelToShadow = Mat4::Viewport * light.WorldToShadowMatrix() * uniforms.model;
 
-	// bind the world to shadow space matrix
-	boundMatrices[SHADOW] = light.WorldToShadowMatrix();
+	// the matrix to transform normals
+	uniforms.normalMatrix = Mat4::GetRotation(rotation.x, rotation.y, rotation.z).Truncate();
 
-	// bind the cameras position
-	boundVectors[CAMERA] = cameraPos;
+	uniforms.cameraPos = cameraPos;
+	uniforms.diffuseColor = diffuseColor;
+	uniforms.pModel = model;
+	uniforms.pLight = &light;
 
-	renderer.DrawElementArray<CowVertex, CowPixel>(nTriangles, pIndices, pVertices, MainVertexShader, MainPixelShader);
+	const LODChain& lods = model->lods;
 
-	boundObject = nullptr;
-	boundLight = nullptr;
+	if ( !model->shortIndices.empty() )
+		renderer.DrawElementArray<CowVertex, CowPixel>(lods.NumTriangles(currentLOD), model->shortIndices[currentLOD].data(), model->pVertices, uniforms, MainVertexShader, MainPixelShader);
+	else
+		renderer.DrawElementArray<CowVertex, CowPixel>(lods.NumTriangles(currentLOD), lods.GetIndices(currentLOD), model->pVertices, uniforms, MainVertexShader, MainPixelShader);
 }
 
 Cow::CowVertex::CowVertex()
 {
 }
 
+#ifdef COW_COMPACT_VERTICES
+Cow::CowVertex::CowVertex(const QuantizedPosition& position, const OctNormal& normal)
+	:
+	position(position), normal(normal)
+{
+}
+#else
 Cow::CowVertex::CowVertex(const Vec4& position, const Vec3& normal)
 	:
 	position(position), normal(normal)
 {
 }
+#endif
 
 Cow::CowPixel::CowPixel()
 {
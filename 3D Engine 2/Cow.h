@@ -1,6 +1,18 @@
 #pragma once
 #include "Renderer.h"
 #include "Light.h"
+#include "LOD.h"
+#include "Quantization.h"
+#include "AssetStreamer.h"
+#include "Mat3.h"
+#include <vector>
+
+class MeshCache;
+struct CachedMesh;
+
+// store positions as 16 bit fractions of the bounding box and normals
+// octahedral encoded, 12 bytes per vertex instead of 32
+#define COW_COMPACT_VERTICES
 
 class Cow
 {
@@ -10,6 +22,14 @@ private:
 	Vec3 diffuseColor = { 1, 0, 0 };
 
 	class CowVertex {
+#ifdef COW_COMPACT_VERTICES
+	public:
+		QuantizedPosition position;
+		OctNormal normal;
+	public:
+		CowVertex();
+		CowVertex(const QuantizedPosition& position, const OctNormal& normal);
+#else
 	public:
 		Vec4 position;
 		Vec3 normal;
@@ -18,6 +38,7 @@ private:
 	public:
 		CowVertex();
 		CowVertex(const Vec4& position, const Vec3& normal);
+#endif
 	};
 
 	class CowPixel : public Renderer::PixelShaderInput {
@@ -34,30 +55,98 @@ private:
 		Vec4& GetPos() override;
 	};
 
-	int nTriangles;
-	int* pIndices;
-	CowVertex* pVertices;
+	// everything the cow draws, built on the streaming thread
+	class Model : public StreamedAsset {
+	public:
+		CowVertex* pVertices = nullptr;
+		int numVertices = 0;
+
+		// index buffers for each level of detail, all share pVertices
+		LODChain lods;
+
+		// the index buffers narrowed to 16 bits when the mesh is small enough,
+		// then lods only keeps the triangle counts and errors
+		std::vector<std::vector<unsigned short>> shortIndices;
+
+		// maps the compact positions back into object space
+		PositionQuantizer quantizer;
+
+		// bounds of the mesh in object space
+		AABB localBounds;
+
+		~Model();
+
+		size_t GetMemoryUsage() const override;
+	};
+
+	// builds a model from the levels of detail starting at firstLevel,
+	// keeping only the vertices those levels use
+	static Model* BuildModel(const CachedMesh& mesh, int firstLevel);
+	static StreamedAsset* LoadModel(const AssetStreamer::Publisher& publish);
+
+	AssetStreamer* streamer = nullptr;
+	AssetStreamer::Handle modelHandle = -1;
 
-	static const Cow* boundObject;
-	static Mat4 boundMatrices[10];
-	static Vec3 boundVectors[5];
-	static const SpotLight* boundLight;
+	// fetched from the streamer once a frame, nullptr until it has loaded
+	const Model* model = nullptr;
+	int currentLOD = 0;
 
-	static CowPixel MainVertexShader(CowVertex& vertex);
-	static Vec4 MainPixelShader(CowPixel& pixel, const Renderer::Sampler<CowPixel>& sampler);
+	// the shaders' per draw constants, built once per draw instead of once per vertex
+	struct MainUniforms {
+		Mat4 mvp;
+		Mat4 model;
 
-	static CowPixel ShadowVertexShader(CowVertex& vertex);
-	static Vec4 ShadowPixelShader(CowPixel& pixel, const Renderer::Sampler<CowPixel>& sampler);
+		// object space to the light's shadow map in viewport space
+		Mat4 modelToShadow;
+
+		// rotates the surface normals
+		Mat3 normalMatrix;
+
+		Vec3 cameraPos;
+		Vec3 diffuseColor;
+
+		const Model* pModel;
+		const SpotLight* pLight;
+	};
+
+	struct ShadowUniforms {
+		Mat4 modelToLight;
+		const Model* pModel;
+	};
+
+	static Vec4 FetchPosition(const CowVertex& vertex, const Model* pModel);
+	static Vec3 FetchNormal(const CowVertex& vertex);
+
+	static CowPixel MainVertexShader(CowVertex& vertex, const MainUniforms& uniforms);
+	static Vec4 MainPixelShader(CowPixel& pixel, const MainUniforms& uniforms, const Renderer::Sampler<CowPixel>& sampler);
+
+	static CowPixel ShadowVertexShader(CowVertex& vertex, const ShadowUniforms& uniforms);
+	static Vec4 ShadowPixelShader(CowPixel& pixel, const ShadowUniforms& uniforms, const Renderer::Sampler<CowPixel>& sampler);
 
 public:
 
 	Cow(const Vec3& position, const Vec3& rotation, const Vec3& scale);
-	~Cow();
+
+	// starts loading the model in the background, nothing is drawn until it arrives
+	void Stream(AssetStreamer& streamer);
+
+	// true once the final version of the model has loaded, not just a coarse one on the way
+	bool IsLoaded() const;
 
 	Vec3 position;
 	Vec3 rotation;
 	Vec3 scale;
 
+	// how far in pixels a simplified level may stray from the full mesh
+	float maxPixelError = 1.0f;
+
+	Mat4 GetModelMatrix() const;
+	AABB GetBoundingBox() const;
+
+	// picks up the latest model from the streamer, call once a frame before anything else
+	void UpdateLOD(const Mat4& proj, const Mat4& view, int viewportHeight);
+	int GetLOD() const;
+
 	void AddToShadowMap(SpotLight& light);
 	void Render(Renderer& renderer, const Mat4& proj, const Mat4& view, const SpotLight& light, const Vec3& cameraPos);
 
@@ -51,7 +51,9 @@ Cubemap::Cubemap(
 	transform(Mat4::GetScale(FAR, FAR, FAR))
 
 {
-
+	// the faces are only ever sampled
+	for (Surface* face : { &this->posx, &this->negx, &this->posy, &this->negy, &this->posz, &this->negz })
+		face->SetLayout(SURFACE_MORTON);
 }
 
 Cubemap::C_Vertex::C_Vertex(const Vec4& position) : position(position) {}
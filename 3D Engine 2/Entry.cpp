@@ -7,8 +7,14 @@
 #include "Shapes.h"
 #include "Light.h"
 #include "Cow.h"
-#include "Queue.h"
+#include "CommandQueue.h"
 #include "Utility.h"
+#include "BVH.h"
+#include "TextureFile.h"
+#include "AssetStreamer.h"
+#include "PostProcessChain.h"
+#include "Benchmark.h"
+#include <vector>
 
 Window* pWindow = nullptr;
 
@@ -30,7 +36,12 @@ SpotLight sl({ 1, 1, 1 }, { 0, 0, 25}, { 0, 0, 0 }, 1.0f, 0.00f, 0.0f, 6, 2048,
 
 Cow cow({0, 0, 15}, {0, PI / 4, 0}, {1, 1, 1});
 
-Surface texture("images/norm.png");
+// loads textures and models in the background
+AssetStreamer streamer;
+AssetStreamer::Handle normalMap = -1;
+
+// the normal map for this frame, the placeholder until it has loaded
+const Surface* texture = nullptr;
 
 Cubemap cb("cube/posx.jpg", 
 	"cube/negx.jpg", 
@@ -41,6 +52,18 @@ Cubemap cb("cube/posx.jpg",
 
 Sphere sphere(20, 2);
 
+// spatial index over everything that gets drawn
+BVH sceneTree;
+int cowProxy = BVH_NULL;
+int terrainProxy = BVH_NULL;
+
+// reused every frame so the queries do not allocate
+std::vector<int> visibleObjects;
+std::vector<int> shadowCasters;
+
+// lights stop affecting objects once their intensity falls below this
+#define MIN_LIGHT_INTENSITY 0.01f
+
 class TestVertex {
 
 public:
@@ -67,8 +90,7 @@ public:
 	Vec3 shadow;
 	Vec3 toCam;
 	Vec3 toLight;
-
-	float padding[3];
+	Vec3 lightDir;
 
 	TestPixel() {}
 	TestPixel(const Vec4& v, const Vec3& normal) : position(v), normal(normal) {}
@@ -79,28 +101,41 @@ public:
 
 };
 
-Vec3 lightD;
-TestPixel TestVertexShader(TestVertex& vertex) {
+// everything the terrain shaders need that is the same for the whole draw
+struct TerrainUniforms {
+
+	Mat4 model;
+	Mat4 viewProjection;
+	Mat4 modelToShadow;
+	Mat3 normalMatrix;
+
+	// in object space
+	Vec3 cameraPos;
+	Vec3 lightPos;
+	Vec3 lightDir;
+
+	const SpotLight* pLight;
+	const Surface* pNormalMap;
+
+};
+
+TestPixel TestVertexShader(TestVertex& vertex, const TerrainUniforms& uniforms) {
 
-	Vec4 worldPos = translation2 * rotation2 * scale2 * vertex.position;
-	Vec4 thing = projection * view * worldPos;
-	Vec3 norm = rotation2.Truncate() * vertex.normal;
+	Vec4 worldPos = uniforms.model * vertex.position;
+	Vec4 thing = uniforms.viewProjection * worldPos;
+	Vec3 norm = uniforms.normalMatrix * vertex.normal;
 
 	TestPixel tp(thing, norm);
 	tp.worldPos = Vec3(worldPos.x, worldPos.y, worldPos.z);
 	tp.texel = vertex.texel;
 
-	Mat4 mObject = translation2 * rotation2 * scale2;
-
-	Vec4 s = Mat4::Viewport * sl.WorldToShadowMatrix() * mObject * vertex.position;
+	Vec4 s = uniforms.modelToShadow * vertex.position;
 	tp.shadow = { s.s, s.t, s.p };
 
-	// get the to cam and to light and lightDirection vectors in OBJECT space
-	tp.toCam = ((translation2 * rotation2 * scale2).GetInverse() * (cameraPos.Vec4() - worldPos)).Vec3();
-	tp.toLight = ((translation2 * rotation2 * scale2).GetInverse() * (sl.GetPosition().Vec4() - worldPos)).Vec3();
-	//tp.toLight = (rotation2.GetInverse() * sl.GetPosition().Vec4()).Vec3();
-
-	lightD = (rotation2.GetInverse() * sl.GetDirection().Vec4()).Vec3();
+	// get the to cam and to light vectors in OBJECT space
+	Vec3 objectPos = vertex.position.Vec3();
+	tp.toCam = uniforms.cameraPos - objectPos;
+	tp.toLight = uniforms.lightPos - objectPos;
 
 	// then transform them to tangent space
 	Mat3 objToTan(vertex.tangent, vertex.bitangent, vertex.normal);
@@ -108,26 +143,24 @@ TestPixel TestVertexShader(TestVertex& vertex) {
 
 	tp.toCam = objToTan * tp.toCam;
 	tp.toLight = objToTan * tp.toLight;
-
-	lightD = objToTan * lightD;
-	lightD = lightD.Normalized();
+	tp.lightDir = objToTan * uniforms.lightDir;
 
 	return tp;
 
 }
 
-Vec4 TestPixelShader(TestPixel& pixel, const Renderer::Sampler<TestPixel>& sampler2d) {
+Vec4 TestPixelShader(TestPixel& pixel, const TerrainUniforms& uniforms, const Renderer::Sampler<TestPixel>& sampler2d) {
 	
-	float fracInShadow = sl.MultiSampleShadowMap(pixel.shadow, 5);
+	float fracInShadow = uniforms.pLight->MultiSampleShadowMap(pixel.shadow, 5);
 	
-	Vec4 normSample = sampler2d.SampleTex2D(texture, FLOAT_OFFSET(pixel, texel));
+	Vec4 normSample = sampler2d.SampleTex2D(*uniforms.pNormalMap, FLOAT_OFFSET(pixel, texel));
 	normSample *= 2;
 	normSample -= Vec4(1, 1, 1, 1);
 
-	Vec3 lightCol = sl.GetColorAt(pixel.worldPos);
+	Vec3 lightCol = uniforms.pLight->GetColorAt(pixel.worldPos);
 
 	// how much the surface faces the light
-	float facingFactor = Light::FacingFactor(lightD, normSample.Vec3());
+	float facingFactor = Light::FacingFactor(pixel.lightDir.Normalized(), normSample.Vec3());
 
 	pixel.toCam = pixel.toCam.Normalized();
 	pixel.toLight = pixel.toLight.Normalized();
@@ -141,7 +174,7 @@ Vec4 TestPixelShader(TestPixel& pixel, const Renderer::Sampler<TestPixel>& sampl
 
 	// the colors based on the materials surface properties
 	// diffuse, specular (specular color will be the light color)
-	Vec3 nonLightCol = Vec3(1, 1, 1) * facingFactor + sl.GetColor() * specFactor;
+	Vec3 nonLightCol = Vec3(1, 1, 1) * facingFactor + uniforms.pLight->GetColor() * specFactor;
 
 	// final non ambient color is the color of the light modulated with
 	// the colors not contributed by the light
@@ -194,6 +227,46 @@ TestVertex terrainVerts[4] = {
 };
 int terrainIndices[6] = {3, 2, 1, 3, 1, 0};
 
+AABB TerrainBoundingBox() {
+
+	return AABB::FromPoints(4, &terrainVerts[0].position, sizeof(TestVertex)).Transformed(translation2 * rotation2 * scale2);
+
+}
+
+static bool Contains(const std::vector<int>& proxies, int proxy) {
+
+	for (int p : proxies)
+		if (p == proxy)
+			return true;
+
+	return false;
+
+}
+
+int PickObject(int mouseX, int mouseY) {
+
+	// mouse position in normalized device coordinates
+	float ndcX = 2.0f * mouseX / pWindow->GetWidth() - 1;
+	float ndcY = 1 - 2.0f * mouseY / pWindow->GetHeight();
+
+	// unproject points on the near and far planes back into the world
+	Mat4 clipToWorld = (projection * view).GetInverse();
+
+	Vec4 nearPoint = clipToWorld * Vec4(ndcX, ndcY, -1, 1);
+	Vec4 farPoint = clipToWorld * Vec4(ndcX, ndcY, 1, 1);
+
+	Vec3 origin = nearPoint.Vec3() / nearPoint.w;
+	Vec3 direction = farPoint.Vec3() / farPoint.w - origin;
+
+	float length = direction.Length();
+
+	std::vector<int> hits;
+	sceneTree.QueryRay(origin, direction / length, length, hits);
+
+	return hits.empty() ? BVH_NULL : hits[0];
+
+}
+
 bool RenderLogic(Renderer& renderer, float deltaTime) {
 
 	projection = Mat4::GetPerspectiveProjection(1, 75, (float)pWindow->GetHeight() / pWindow->GetWidth(), fov, projFrustum);
@@ -274,15 +347,58 @@ bool RenderLogic(Renderer& renderer, float deltaTime) {
 	
 	sl.UpdateShadowBox(projFrustum, camToWorld);
 
-	cow.AddToShadowMap(sl);
+	// pick how detailed the cow needs to be at its distance
+	cow.UpdateLOD(projection, view, pWindow->GetHeight());
+
+	texture = &streamer.GetTexture(normalMap);
+
+	// refit anything that may have moved this frame
+	sceneTree.Move(cowProxy, cow.GetBoundingBox());
+	sceneTree.Move(terrainProxy, TerrainBoundingBox());
+
+	// only objects the light can reach need to be in its shadow map
+	shadowCasters.clear();
+	sceneTree.QuerySphere(sl.GetPosition(), sl.GetRange(MIN_LIGHT_INTENSITY), shadowCasters);
+
+	sl.BeginShadowPass(renderer);
 
-	cow.Render(renderer, projection, view, sl, cameraPos);
+	if ( Contains(shadowCasters, cowProxy) )
+		cow.AddToShadowMap(sl);
+
+	sl.EndShadowPass();
+
+	// only draw objects inside the view frustum
+	visibleObjects.clear();
+	sceneTree.QueryFrustum(projection * view, visibleObjects);
+
+	if ( Contains(visibleObjects, cowProxy) )
+		cow.Render(renderer, projection, view, sl, cameraPos);
 	//cb.Render(renderer, Mat4::GetRotation(cameraRot.x, cameraRot.y, cameraRot.z).GetInverse(), projection);
 	
-	renderer.DrawElementArray<TestVertex, TestPixel>(2, terrainIndices, terrainVerts, TestVertexShader, TestPixelShader);
+	if ( Contains(visibleObjects, terrainProxy) ) {
+
+		TerrainUniforms uniforms;
+
+		uniforms.model = translation2 * rotation2 * scale2;
+		uniforms.viewProjection = projection * view;
+		uniforms.modelToShadow = Mat4::Viewport * sl.WorldToShadowMatrix() * uniforms.model;
+		uniforms.normalMatrix = rotation2.Truncate();
+
+		Mat4 modelInverse = uniforms.model.GetInverse();
+		uniforms.cameraPos = (modelInverse * cameraPos.Vec4()).Vec3();
+		uniforms.lightPos = (modelInverse * sl.GetPosition().Vec4()).Vec3();
+		uniforms.lightDir = (rotation2.GetInverse() * sl.GetDirection().Vec4()).Vec3();
+
+		uniforms.pLight = &sl;
+		uniforms.pNormalMap = texture;
 
-	sl.ClearShadowMap();
+		renderer.DrawElementArray<TestVertex, TestPixel>(2, terrainIndices, terrainVerts, uniforms, TestVertexShader, TestPixelShader);
+	}
 
+	// nothing from the streamer is used past this point, but the frame may still be
+	// drawn on the raster thread, so its assets are released after its draws
+	long long frame = streamer.EndFrame();
+	renderer.RunInOrder([frame](Renderer&) { streamer.ReleaseFrame(frame); });
 	
 	return false;
 
@@ -291,8 +407,7 @@ bool RenderLogic(Renderer& renderer, float deltaTime) {
 bool PostProcess(Surface& frontBuffer) {
 
 	//frontBuffer.GaussianBlur(10, 3, Surface::BLUR_BOTH);
-	//frontBuffer.Invert();
-	//frontBuffer.SetContrast(0.3);
+	//PostProcessChain().Invert().Contrast(0.3f).Apply(frontBuffer);
 
 	int numKeys;
 	const Uint8* keyboard = SDL_GetKeyboardState(&numKeys);
@@ -304,7 +419,7 @@ bool PostProcess(Surface& frontBuffer) {
 	return false;
 }
 
-bool EventHandler(Queue<int>& commandQueue)
+bool EventHandler(CommandQueue<Command>& commandQueue)
 {
 	
 	SDL_Event event = {};
@@ -327,11 +442,25 @@ bool EventHandler(Queue<int>& commandQueue)
 
 			break;
 
+		case SDL_MOUSEBUTTONDOWN:
+
+			// mouse picking only makes sense when the cursor is visible
+			if ( event.button.button == SDL_BUTTON_LEFT && SDL_GetRelativeMouseMode() == SDL_FALSE ) {
+
+				int picked = PickObject(event.button.x, event.button.y);
+
+				if ( picked == cowProxy )
+					std::cout << "Picked the cow" << std::endl;
+				else if ( picked == terrainProxy )
+					std::cout << "Picked the terrain" << std::endl;
+			}
+
+			break;
+
 		case SDL_KEYDOWN:
 
 			if ( event.key.keysym.scancode == SDL_SCANCODE_J ) {
-				commandQueue.Enqueue(C_TOGGLE_FLAG);
-				commandQueue.Enqueue(RF_WIREFRAME);
+				commandQueue.Enqueue({ C_TOGGLE_FLAG, 0, 0, RF_WIREFRAME });
 			}
 
 			break;
@@ -340,9 +469,7 @@ bool EventHandler(Queue<int>& commandQueue)
 			switch ( event.window.event ) {
 
 			case SDL_WINDOWEVENT_RESIZED:
-				commandQueue.Enqueue(C_RESIZE);
-				commandQueue.Enqueue(event.window.data1);
-				commandQueue.Enqueue(event.window.data2);
+				commandQueue.Enqueue({ C_RESIZE, event.window.data1, event.window.data2, 0 });
 				break;
 
 			}
@@ -357,20 +484,43 @@ bool EventHandler(Queue<int>& commandQueue)
 
 int main(int argc, char* argv[]) {
 
-	/*TestVertex v1;
-	TestVertex v2;
+	// converts images into memory mappable textures and exits
+	// usage: --convert images/cow.png --bc5 images/norm.png --bc1 cube/posx.jpg ...
+	// a format flag applies to every image after it
+	if ( argc > 1 && std::string(argv[1]) == "--convert" ) {
 
-	double start = (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
-	for ( int i = 0; i < 10000000; ++i ) {
-		TestVertex v3 = Lerp(v1, v2, 0.5);
+		int compression = SURFACE_UNCOMPRESSED;
+		int failed = 0;
+
+		for ( int i = 2; i < argc; ++i ) {
+
+			std::string arg = argv[i];
+
+			if ( arg == "--none" )
+				compression = SURFACE_UNCOMPRESSED;
+			else if ( arg == "--bc1" )
+				compression = SURFACE_BC1;
+			else if ( arg == "--bc3" )
+				compression = SURFACE_BC3;
+			else if ( arg == "--bc5" )
+				compression = SURFACE_BC5;
+			else if ( !TextureFile::Convert(arg, compression) )
+				++failed;
+		}
+
+		return failed;
 	}
-	double end = (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
-	std::cout << (end - start) << std::endl;
-	return 0;*/
+
+	// renders the benchmark scenes offscreen, without a window, and writes the results as JSON
+	// usage: --benchmark [results.json] [only scenes with this in their name]
+	if ( argc > 1 && std::string(argv[1]) == "--benchmark" )
+		return Benchmark::Run(argc > 2 ? argv[2] : BENCHMARK_RESULTS_FILE, argc > 3 ? argv[3] : "");
 
 	SDL_Init(SDL_INIT_VIDEO);
 
-	texture.GenerateMipMaps();
+	// flat normals until the real map arrives, only x and y need storing
+	normalMap = streamer.RequestTexture("images/norm.png", { 0.5f, 0.5f, 1, 1 }, SURFACE_BC5);
+	cow.Stream(streamer);
 	
 	Instance::Init();
 
@@ -387,6 +537,9 @@ int main(int argc, char* argv[]) {
 	//texture.GenerateMipMaps();
 	//texture.Tint({ 1, 0, 0, 1 }, 0.2);
 
+	cowProxy = sceneTree.Insert(cow.GetBoundingBox(), &cow);
+	terrainProxy = sceneTree.Insert(TerrainBoundingBox(), terrainVerts);
+
 	// 2560, 1440
 	Window window("My Window", 20, 20, 750, 750, SDL_WINDOW_RESIZABLE);
 	pWindow = &window;
@@ -3,24 +3,25 @@
 #include <assimp/postprocess.h>
 
 #include "Importing.h"
+#include "MeshOptimizer.h"
 
 
 /////// MESH ////////
 
-Mesh::Mesh(const aiMesh* ai_mesh)
+Mesh::Mesh(const aiMesh* ai_mesh, const MeshData* data)
 	:
-	ai_mesh(ai_mesh)
+	ai_mesh(ai_mesh), data(data)
 {
 }
 
 int Mesh::NumTriangles() const
 {
-	return ai_mesh->mNumFaces;
+	return (int)data->indices.size() / 3;
 }
 
 int Mesh::Indices(int index) const
 {
-	return ai_mesh->mFaces[index / 3].mIndices[index % 3];
+	return data->indices[index];
 }
 
 int Mesh::NumVertices() const
@@ -30,7 +31,7 @@ int Mesh::NumVertices() const
 
 Vec3 Mesh::Positions(int index) const
 {
-	aiVector3D vec = ai_mesh->mVertices[index];
+	aiVector3D vec = ai_mesh->mVertices[data->vertexOrder[index]];
 	return { vec.x, vec.y, vec.z };
 }
 
@@ -41,7 +42,7 @@ bool Mesh::HasNormals() const
 
 Vec3 Mesh::Normals(int index) const
 {
-	aiVector3D vec = ai_mesh->mNormals[index];
+	aiVector3D vec = ai_mesh->mNormals[data->vertexOrder[index]];
 	return { vec.x, vec.y, vec.z };
 }
 
@@ -52,7 +53,7 @@ bool Mesh::HasTextureCoords() const
 
 Vec2 Mesh::TextureCoords(int index) const
 {
-	aiVector3D vec = ai_mesh->mTextureCoords[0][index];
+	aiVector3D vec = ai_mesh->mTextureCoords[0][data->vertexOrder[index]];
 	return { vec.x, 1 - vec.y };
 }
 
@@ -63,7 +64,7 @@ bool Mesh::HasColors() const
 
 Vec3 Mesh::Colors(int index) const
 {
-	aiColor4D vec = ai_mesh->mColors[0][index];
+	aiColor4D vec = ai_mesh->mColors[0][data->vertexOrder[index]];
 	return { vec.r, vec.g, vec.b };
 }
 
@@ -74,13 +75,13 @@ bool Mesh::HasTangentsAndBitangents() const
 
 Vec3 Mesh::Tangents(int index) const
 {
-	aiVector3D vec = ai_mesh->mTangents[index];
+	aiVector3D vec = ai_mesh->mTangents[data->vertexOrder[index]];
 	return { vec.x, vec.y, vec.z };
 }
 
 Vec3 Mesh::Bitangents(int index) const
 {
-	aiVector3D vec = ai_mesh->mBitangents[index];
+	aiVector3D vec = ai_mesh->mBitangents[data->vertexOrder[index]];
 	return { vec.x, vec.y, vec.z };
 }
 
@@ -89,6 +90,11 @@ int Mesh::MaterialID() const
 	return ai_mesh->mMaterialIndex;
 }
 
+const LODChain& Mesh::LODs() const
+{
+	return data->lods;
+}
+
 
 /////// MATERIAL ////////
 
@@ -198,24 +204,82 @@ std::string Material::GlossMap() const
 
 /////// SCENE ////////
 
-Scene::Scene(const std::string& filepath)
+Scene::Scene(const std::string& filepath, int numLODs)
 	:
 	directory(filepath.substr(0, filepath.find_last_of("/") + 1))
 {
 	ai_scene = ai_importer.ReadFile(filepath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
 
-	if ( ai_scene == nullptr )
+	if ( ai_scene == nullptr ) {
 		std::cout << ai_importer.GetErrorString() << std::endl;
+		return;
+	}
+
+	meshData.resize(ai_scene->mNumMeshes);
+
+	for ( unsigned int m = 0; m < ai_scene->mNumMeshes; ++m ) {
+
+		const aiMesh* mesh = ai_scene->mMeshes[m];
+		MeshData& md = meshData[m];
+
+		// triangulation can leave points and lines behind, they are skipped
+		md.indices.reserve(mesh->mNumFaces * 3);
+		for ( unsigned int f = 0; f < mesh->mNumFaces; ++f )
+			if ( mesh->mFaces[f].mNumIndices == 3 )
+				md.indices.insert(md.indices.end(), mesh->mFaces[f].mIndices, mesh->mFaces[f].mIndices + 3);
+
+		int numTriangles = (int)md.indices.size() / 3;
+		int numVertices = mesh->mNumVertices;
+
+		if ( numTriangles == 0 ) {
+
+			for ( int v = 0; v < numVertices; ++v )
+				md.vertexOrder.push_back(v);
+
+			continue;
+		}
+
+		const float* positions = (const float*)mesh->mVertices;
+		const int stride = sizeof(aiVector3D) / sizeof(float);
+
+		// order triangles for the vertex cache, then for overdraw, then number
+		// the vertices in the order the triangles use them
+		std::vector<int> clusters;
+		MeshOptimizer::OptimizeVertexCache(md.indices.data(), numTriangles, numVertices, &clusters);
+		MeshOptimizer::OptimizeOverdraw(md.indices.data(), numTriangles, positions, stride, clusters);
+		MeshOptimizer::OptimizeVertexFetch(md.indices.data(), numTriangles, numVertices, md.vertexOrder);
+
+		// positions in the new vertex order for the simplifier
+		std::vector<float> ordered(numVertices * 3);
+		for ( int v = 0; v < numVertices; ++v ) {
+
+			const aiVector3D& p = mesh->mVertices[md.vertexOrder[v]];
+
+			ordered[v * 3] = p.x;
+			ordered[v * 3 + 1] = p.y;
+			ordered[v * 3 + 2] = p.z;
+		}
+
+		// build the level of detail chain, the simplified levels get the same cache ordering
+		md.lods.Build(numVertices, ordered.data(), 3, numTriangles, md.indices.data(), numLODs);
+
+		for ( int level = 1; level < md.lods.NumLevels(); ++level )
+			MeshOptimizer::OptimizeVertexCache(md.lods.GetIndices(level), md.lods.NumTriangles(level), numVertices);
+	}
 }
 
 int Scene::NumMeshes() const
 {
+	// the file could not be imported
+	if ( ai_scene == nullptr )
+		return 0;
+
 	return ai_scene->mNumMeshes;
 }
 
 Mesh Scene::MeshAt(int meshIndex) const
 {
-	return { ai_scene->mMeshes[meshIndex] };
+	return { ai_scene->mMeshes[meshIndex], &meshData[meshIndex] };
 }
 
 int Scene::NumMaterials() const
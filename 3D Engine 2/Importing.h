@@ -2,7 +2,9 @@
 #include <assimp/Importer.hpp>
 #include "Vec3.h"
 #include "Vec2.h"
+#include "LOD.h"
 #include <string>
+#include <vector>
 
 // WRAPPER FOR THE ASSIMP LIBRARY
 
@@ -14,6 +16,19 @@ class aiScene;
 class Scene;
 class Mesh;
 
+// what the scene builds for each mesh when it is imported
+struct MeshData {
+
+	// triangles in vertex cache friendly order, indexing the reordered vertices
+	std::vector<int> indices;
+
+	// the assimp vertex index of each vertex, in the order they are first used
+	std::vector<int> vertexOrder;
+
+	LODChain lods;
+
+};
+
 class Mesh {
 
 	friend class Scene;
@@ -21,8 +36,9 @@ class Mesh {
 private:
 
 	const aiMesh* ai_mesh;
+	const MeshData* data;
 
-	Mesh(const aiMesh* ai_mesh);
+	Mesh(const aiMesh* ai_mesh, const MeshData* data);
 
 public:
 
@@ -48,6 +64,9 @@ public:
 
 	int MaterialID() const;
 
+	// simplified versions of this mesh, built when the scene was imported
+	const LODChain& LODs() const;
+
 };
 
 class Material {
@@ -88,9 +107,12 @@ private:
 	const aiScene* ai_scene;
 	const std::string directory;
 
+	// one per mesh
+	std::vector<MeshData> meshData;
+
 public:
 
-	Scene(const std::string& filepath);
+	Scene(const std::string& filepath, int numLODs = LOD_DEFAULT_LEVELS);
 
 	int NumMeshes() const;
 	Mesh MeshAt(int meshIndex) const;
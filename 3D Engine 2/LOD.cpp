@@ -0,0 +1,426 @@
+#include "LOD.h"
+#include "Vec4.h"
+#include <math.h>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+
+// how strongly open edges resist being collapsed
+#define BORDER_WEIGHT 10.0
+
+// symmetric 4x4 matrix, stored as its upper triangle
+struct Quadric {
+
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+
+	Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0) {}
+
+	// quadric measuring squared distance to the plane nx + d = 0
+	Quadric(double a, double b, double c, double d, double weight)
+		:
+		a00(a * a * weight), a01(a * b * weight), a02(a * c * weight), a03(a * d * weight),
+		a11(b * b * weight), a12(b * c * weight), a13(b * d * weight),
+		a22(c * c * weight), a23(c * d * weight),
+		a33(d * d * weight)
+	{
+	}
+
+	Quadric& operator+=(const Quadric& q) {
+
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+
+		return *this;
+	}
+
+	Quadric operator+(const Quadric& q) const {
+
+		Quadric sum = *this;
+		sum += q;
+		return sum;
+	}
+
+	double Evaluate(const Vec3& v) const {
+
+		double x = v.x, y = v.y, z = v.z;
+
+		return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+			+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+			+ a22 * z * z + 2 * a23 * z
+			+ a33;
+	}
+
+};
+
+struct Collapse {
+
+	double cost;
+
+	int source;
+	int target;
+
+	// versions of the vertices when this was pushed, stale entries are skipped
+	unsigned int sourceVersion;
+	unsigned int targetVersion;
+
+	bool operator>(const Collapse& c) const {
+		return cost > c.cost;
+	}
+
+};
+
+class Simplifier {
+
+private:
+
+	int numVertices;
+	std::vector<Vec3> positions;
+	std::vector<Quadric> quadrics;
+	std::vector<unsigned int> versions;
+
+	// which vertex each vertex has been collapsed into
+	std::vector<int> remap;
+
+	std::vector<int> triangles;
+	std::vector<bool> alive;
+	std::vector<std::vector<int>> vertexTriangles;
+
+	int liveTriangles;
+	double maxCost = 0;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+	void PushEdge(int a, int b) {
+
+		Quadric q = quadrics[a] + quadrics[b];
+
+		// collapse onto whichever endpoint leaves less error
+		double costAB = q.Evaluate(positions[b]);
+		double costBA = q.Evaluate(positions[a]);
+
+		if (costAB <= costBA)
+			heap.push({ fmax(costAB, 0), a, b, versions[a], versions[b] });
+		else
+			heap.push({ fmax(costBA, 0), b, a, versions[b], versions[a] });
+	}
+
+	bool CausesFlip(int source, int target) const {
+
+		// moving source onto target must not turn any of its triangles over
+		for (int t : vertexTriangles[source]) {
+
+			if (!alive[t])
+				continue;
+
+			const int* tri = &triangles[t * 3];
+
+			if (tri[0] == target || tri[1] == target || tri[2] == target)
+				continue;
+
+			Vec3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+			Vec3 before = (p[1] - p[0]) % (p[2] - p[0]);
+
+			for (int i = 0; i < 3; ++i)
+				if (tri[i] == source)
+					p[i] = positions[target];
+
+			Vec3 after = (p[1] - p[0]) % (p[2] - p[0]);
+
+			if (before * after <= 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	void DoCollapse(int source, int target) {
+
+		remap[source] = target;
+		quadrics[target] += quadrics[source];
+
+		++versions[source];
+		++versions[target];
+
+		for (int t : vertexTriangles[source]) {
+
+			if (!alive[t])
+				continue;
+
+			int* tri = &triangles[t * 3];
+
+			// triangles on the collapsed edge disappear
+			if (tri[0] == target || tri[1] == target || tri[2] == target) {
+				alive[t] = false;
+				--liveTriangles;
+				continue;
+			}
+
+			for (int i = 0; i < 3; ++i)
+				if (tri[i] == source)
+					tri[i] = target;
+
+			vertexTriangles[target].push_back(t);
+		}
+
+		vertexTriangles[source].clear();
+
+		// the costs of every edge around the target changed
+		for (int t : vertexTriangles[target]) {
+
+			if (!alive[t])
+				continue;
+
+			const int* tri = &triangles[t * 3];
+
+			for (int i = 0; i < 3; ++i)
+				if (tri[i] != target)
+					PushEdge(target, tri[i]);
+		}
+	}
+
+public:
+
+	Simplifier(int numVertices, const float* pos, int stride, int numTriangles, const int* indices)
+		:
+		numVertices(numVertices), positions(numVertices), quadrics(numVertices), versions(numVertices, 0),
+		remap(numVertices), triangles(indices, indices + numTriangles * 3), alive(numTriangles, true),
+		vertexTriangles(numVertices), liveTriangles(numTriangles)
+	{
+
+		for (int i = 0; i < numVertices; ++i) {
+			positions[i] = { pos[i * stride], pos[i * stride + 1], pos[i * stride + 2] };
+			remap[i] = i;
+		}
+
+		// count how many triangles share each edge to find the open borders
+		std::unordered_map<long long, int> edgeCounts;
+		edgeCounts.reserve(numTriangles * 3);
+
+		for (int t = 0; t < numTriangles; ++t) {
+			for (int i = 0; i < 3; ++i) {
+
+				int a = triangles[t * 3 + i];
+				int b = triangles[t * 3 + (i + 1) % 3];
+
+				++edgeCounts[(long long)std::min(a, b) * numVertices + std::max(a, b)];
+			}
+		}
+
+		for (int t = 0; t < numTriangles; ++t) {
+
+			const int* tri = &triangles[t * 3];
+
+			Vec3 normal = (positions[tri[1]] - positions[tri[0]]) % (positions[tri[2]] - positions[tri[0]]);
+			float length = normal.Length();
+
+			if (length == 0)
+				continue;
+
+			normal /= length;
+
+			// every vertex gets the plane of each triangle around it
+			Quadric plane(normal.x, normal.y, normal.z, -(normal * positions[tri[0]]), 1.0);
+
+			for (int i = 0; i < 3; ++i) {
+
+				quadrics[tri[i]] += plane;
+				vertexTriangles[tri[i]].push_back(t);
+			}
+
+			// a plane perpendicular to the triangle along each open edge keeps borders in place
+			for (int i = 0; i < 3; ++i) {
+
+				int a = tri[i];
+				int b = tri[(i + 1) % 3];
+
+				if (edgeCounts[(long long)std::min(a, b) * numVertices + std::max(a, b)] != 1)
+					continue;
+
+				Vec3 edgeNormal = ((positions[b] - positions[a]) % normal).Normalized();
+				Quadric border(edgeNormal.x, edgeNormal.y, edgeNormal.z, -(edgeNormal * positions[a]), BORDER_WEIGHT);
+
+				quadrics[a] += border;
+				quadrics[b] += border;
+			}
+		}
+
+		for (int t = 0; t < numTriangles; ++t)
+			for (int i = 0; i < 3; ++i)
+				PushEdge(triangles[t * 3 + i], triangles[t * 3 + (i + 1) % 3]);
+	}
+
+	// collapses edges until at most targetTriangles remain, or nothing more can be collapsed
+	void Simplify(int targetTriangles) {
+
+		while (liveTriangles > targetTriangles && !heap.empty()) {
+
+			Collapse c = heap.top();
+			heap.pop();
+
+			// either end has changed since this entry was pushed
+			if (remap[c.source] != c.source || remap[c.target] != c.target)
+				continue;
+			if (versions[c.source] != c.sourceVersion || versions[c.target] != c.targetVersion)
+				continue;
+
+			if (CausesFlip(c.source, c.target))
+				continue;
+
+			maxCost = fmax(maxCost, c.cost);
+			DoCollapse(c.source, c.target);
+		}
+	}
+
+	int NumTriangles() const {
+		return liveTriangles;
+	}
+
+	float GetError() const {
+		return (float)sqrt(maxCost);
+	}
+
+	void GetIndices(std::vector<int>& out) const {
+
+		out.clear();
+		out.reserve(liveTriangles * 3);
+
+		for (int t = 0; t < (int)alive.size(); ++t)
+			if (alive[t])
+				out.insert(out.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+	}
+
+};
+
+LODChain::LODChain() {}
+
+void LODChain::Build(int numVertices, const float* positions, int stride, int numTriangles, const int* indices, int maxLevels, float reduction)
+{
+	levels.clear();
+
+	// level 0 is the original mesh
+	levels.push_back({ std::vector<int>(indices, indices + numTriangles * 3), numTriangles, 0 });
+
+	// bounding sphere around the center of the bounding box
+	Vec3 min(positions[0], positions[1], positions[2]);
+	Vec3 max = min;
+
+	for (int i = 1; i < numVertices; ++i) {
+
+		const float* p = positions + i * stride;
+
+		min = { fminf(min.x, p[0]), fminf(min.y, p[1]), fminf(min.z, p[2]) };
+		max = { fmaxf(max.x, p[0]), fmaxf(max.y, p[1]), fmaxf(max.z, p[2]) };
+	}
+
+	center = (min + max) * 0.5f;
+	radius = 0;
+
+	for (int i = 0; i < numVertices; ++i) {
+
+		const float* p = positions + i * stride;
+		radius = fmaxf(radius, (Vec3(p[0], p[1], p[2]) - center).Length());
+	}
+
+	// each level continues simplifying where the last one stopped
+	Simplifier simplifier(numVertices, positions, stride, numTriangles, indices);
+
+	for (int level = 1; level < maxLevels; ++level) {
+
+		int previous = simplifier.NumTriangles();
+
+		simplifier.Simplify((int)(previous * reduction));
+
+		// the mesh could not be simplified much further
+		if (simplifier.NumTriangles() > previous * (1 - LOD_MIN_REDUCTION) || simplifier.NumTriangles() == 0)
+			break;
+
+		Level l;
+		simplifier.GetIndices(l.indices);
+		l.numTriangles = simplifier.NumTriangles();
+		l.error = simplifier.GetError();
+
+		levels.push_back(std::move(l));
+	}
+
+}
+
+void LODChain::Reset(const Vec3& center, float radius)
+{
+	levels.clear();
+
+	this->center = center;
+	this->radius = radius;
+}
+
+void LODChain::AddLevel(const int* indices, int numTriangles, float error)
+{
+	levels.push_back({ std::vector<int>(indices, indices + numTriangles * 3), numTriangles, error });
+}
+
+void LODChain::DropIndices()
+{
+	for (Level& level : levels)
+		std::vector<int>().swap(level.indices);
+}
+
+int LODChain::NumLevels() const {
+	return (int)levels.size();
+}
+
+int LODChain::NumTriangles(int level) const {
+	return levels[level].numTriangles;
+}
+
+int* LODChain::GetIndices(int level) {
+	return levels[level].indices.empty() ? nullptr : levels[level].indices.data();
+}
+
+const int* LODChain::GetIndices(int level) const {
+	return levels[level].indices.empty() ? nullptr : levels[level].indices.data();
+}
+
+float LODChain::GetError(int level) const {
+	return levels[level].error;
+}
+
+const Vec3& LODChain::GetCenter() const {
+	return center;
+}
+
+float LODChain::GetRadius() const {
+	return radius;
+}
+
+int LODChain::SelectLevel(const Mat4& modelView, float projectionScale, int viewportHeight, float maxPixelError) const
+{
+	if (levels.size() <= 1)
+		return 0;
+
+	// largest scale factor of the model view matrix, so errors and the radius are in camera space units
+	float scale = fmaxf(fmaxf(modelView[0].Vec3().Length(), modelView[1].Vec3().Length()), modelView[2].Vec3().Length());
+
+	Vec4 viewCenter = modelView * center.Vec4();
+
+	// camera looks down -z
+	float distance = -viewCenter.z;
+	float viewRadius = radius * scale;
+
+	// the camera is inside the bounding sphere, use the full mesh
+	if (distance <= viewRadius)
+		return 0;
+
+	// how many pixels one camera space unit covers at the sphere's distance
+	float pixelsPerUnit = projectionScale * viewportHeight / (2 * distance);
+
+	// the coarsest level that is still accurate enough
+	for (int level = (int)levels.size() - 1; level > 0; --level)
+		if (levels[level].error * scale * pixelsPerUnit <= maxPixelError)
+			return level;
+
+	return 0;
+}
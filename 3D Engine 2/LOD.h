@@ -0,0 +1,84 @@
+#pragma once
+#include "Vec3.h"
+#include "Mat4.h"
+#include <vector>
+
+// default number of levels built for every mesh imported through a Scene, including the full mesh
+#define LOD_DEFAULT_LEVELS 4
+
+// fraction of the previous level's triangles each new level aims for
+#define LOD_DEFAULT_REDUCTION 0.5f
+
+// a level is dropped from the chain if it could not remove at least this fraction of the triangles
+#define LOD_MIN_REDUCTION 0.1f
+
+// Chain of progressively simplified index buffers for one mesh.
+// Every level indexes the same vertex buffer as the original mesh,
+// simplification only collapses edges onto vertices that already exist,
+// so no vertex attributes need to be recomputed.
+// Simplification uses the quadric error metric from
+// "Surface Simplification Using Quadric Error Metrics", Garland, Heckbert
+class LODChain {
+
+public:
+
+	struct Level {
+
+		std::vector<int> indices;
+		int numTriangles;
+
+		// largest distance in object space the surface moved from the original
+		float error;
+
+	};
+
+private:
+
+	std::vector<Level> levels;
+
+	// bounding sphere of the mesh in object space
+	Vec3 center;
+	float radius = 0;
+
+public:
+
+	LODChain();
+
+	// positions are floats with stride floats between each vertex
+	// level 0 is always the unsimplified mesh
+	void Build(
+		int numVertices,
+		const float* positions,
+		int stride,
+		int numTriangles,
+		const int* indices,
+		int maxLevels = LOD_DEFAULT_LEVELS,
+		float reduction = LOD_DEFAULT_REDUCTION
+	);
+
+	// restores a chain saved earlier, Reset clears it and AddLevel
+	// is called once for each level starting from the full mesh
+	void Reset(const Vec3& center, float radius);
+	void AddLevel(const int* indices, int numTriangles, float error);
+
+	// frees every level's indices but keeps their triangle counts and errors,
+	// for meshes that keep their index buffers in another format
+	void DropIndices();
+
+	int NumLevels() const;
+
+	int NumTriangles(int level) const;
+	// nullptr after DropIndices
+	int* GetIndices(int level);
+	const int* GetIndices(int level) const;
+	float GetError(int level) const;
+
+	const Vec3& GetCenter() const;
+	float GetRadius() const;
+
+	// picks the coarsest level whose error, projected to the screen, stays under maxPixelError
+	// modelView must take the mesh into camera space, projectionScale is the
+	// projection matrix's (1, 1) entry and viewportHeight is in pixels
+	int SelectLevel(const Mat4& modelView, float projectionScale, int viewportHeight, float maxPixelError) const;
+
+};
@@ -230,6 +230,26 @@ void DirectionalLight::ClearShadowMap()
 
 }
 
+void DirectionalLight::BeginShadowPass(Renderer& frameRenderer)
+{
+	frameRenderer.RunInOrder([this](Renderer&) { ClearShadowMap(); });
+
+	if ( !frameRenderer.IsRecording() )
+		return;
+
+	// the draws are recorded by the frame, but land in the shadow map
+	frameRenderer.SetRecordingTarget(&shadowMapRenderer);
+	pShadowPassRenderer = &frameRenderer;
+}
+
+void DirectionalLight::EndShadowPass()
+{
+	if ( pShadowPassRenderer != nullptr )
+		pShadowPassRenderer->SetRecordingTarget(nullptr);
+
+	pShadowPassRenderer = nullptr;
+}
+
 Mat4 DirectionalLight::WorldToShadowMatrix() const
 {
 	return orthographicProjection * viewMatrix;
@@ -297,6 +317,23 @@ Vec3 SpotLight::GetColorAt(const Vec3& position) const
 
 }
 
+float SpotLight::GetRange(float minIntensity) const
+{
+	// distance where the attenuation drops the intensity to minIntensity,
+	// found by solving quadratic * d^2 + linear * d + constant = 1 / minIntensity
+
+	float c = constant - 1.0f / minIntensity;
+
+	if ( quadratic > 0 )
+		return (-linear + sqrtf(linear * linear - 4 * quadratic * c)) / (2 * quadratic);
+
+	if ( linear > 0 )
+		return fmaxf(-c / linear, 0);
+
+	// the light never falls off
+	return LARGE_DEPTH;
+}
+
 void SpotLight::SetColor(const Vec3& color)
 {
 	this->color = color;
@@ -418,6 +455,26 @@ void SpotLight::ClearShadowMap()
 	shadowMapRenderer.ClearDepthBuffer();
 }
 
+void SpotLight::BeginShadowPass(Renderer& frameRenderer)
+{
+	frameRenderer.RunInOrder([this](Renderer&) { ClearShadowMap(); });
+
+	if ( !frameRenderer.IsRecording() )
+		return;
+
+	// the draws are recorded by the frame, but land in the shadow map
+	frameRenderer.SetRecordingTarget(&shadowMapRenderer);
+	pShadowPassRenderer = &frameRenderer;
+}
+
+void SpotLight::EndShadowPass()
+{
+	if ( pShadowPassRenderer != nullptr )
+		pShadowPassRenderer->SetRecordingTarget(nullptr);
+
+	pShadowPassRenderer = nullptr;
+}
+
 Mat4 SpotLight::WorldToShadowMatrix() const
 {
 	return perspectiveProjection * viewMatrix;
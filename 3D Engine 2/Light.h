@@ -25,6 +25,13 @@ private:
 	Mat4 orthographicProjection;
 	Renderer shadowMapRenderer;
 
+	// the frame renderer recording this pass, see BeginShadowPass
+	Renderer* pShadowPassRenderer = nullptr;
+
+	Renderer& ShadowPassRenderer() {
+		return pShadowPassRenderer != nullptr ? *pShadowPassRenderer : shadowMapRenderer;
+	}
+
 public:
 
 	DirectionalLight(const Vec3& color, const Vec3& rotation);
@@ -40,10 +47,25 @@ public:
 
 	void UpdateShadowBox(const Frustum& viewFrustum, const Mat4& camToWorldMatrix);
 
-	template <class Vertex, class Pixel>
-	void DrawToShadowMap(int numIndexGroups, int* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader) {
+	// clears the shadow map for the draws up to EndShadowPass. while frameRenderer is
+	// recording, the clear and the draws go into its list, so the map is only touched
+	// by the thread executing the list, in order with the draws that sample it
+	void BeginShadowPass(Renderer& frameRenderer);
+	void EndShadowPass();
+
+	template <class Vertex, class Pixel, class Index>
+	void DrawToShadowMap(int numIndexGroups, const Index* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader) {
+
+		PROFILE_SCOPE("Shadow Pass");
+		ShadowPassRenderer().DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, VertexShadowShader, PixelShadowShader);
+
+	}
+
+	template <class Vertex, class Pixel, class Uniforms, class Index>
+	void DrawToShadowMap(int numIndexGroups, const Index* indices, Vertex* vertices, const Uniforms& uniforms, Renderer::UNIFORM_VS_TYPE<Vertex, Pixel, Uniforms> VertexShadowShader, Renderer::UNIFORM_PS_TYPE<Pixel, Uniforms> PixelShadowShader) {
 
-		shadowMapRenderer.DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, VertexShadowShader, PixelShadowShader);
+		PROFILE_SCOPE("Shadow Pass");
+		ShadowPassRenderer().DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, uniforms, VertexShadowShader, PixelShadowShader);
 
 	}
 
@@ -80,6 +102,13 @@ private:
 
 	Renderer shadowMapRenderer;
 
+	// the frame renderer recording this pass, see BeginShadowPass
+	Renderer* pShadowPassRenderer = nullptr;
+
+	Renderer& ShadowPassRenderer() {
+		return pShadowPassRenderer != nullptr ? *pShadowPassRenderer : shadowMapRenderer;
+	}
+
 public:
 
 	SpotLight(const Vec3& color, const Vec3& position, const Vec3& rotation, float constant, float linear, float quadratic, float exponent);
@@ -92,6 +121,7 @@ public:
 	const Vec3& GetDirection() const;
 
 	Vec3 GetColorAt(const Vec3& position) const;
+	float GetRange(float minIntensity) const;
 
 	void SetColor(const Vec3& color);
 	void SetPosition(const Vec3& position);
@@ -101,10 +131,22 @@ public:
 
 	void UpdateShadowBox(const Frustum& viewFrustum, const Mat4& camToWorldMatrix);
 
-	template <class Vertex, class Pixel>
-	void DrawToShadowMap(int numIndexGroups, int* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader)
+	// same as DirectionalLight::BeginShadowPass
+	void BeginShadowPass(Renderer& frameRenderer);
+	void EndShadowPass();
+
+	template <class Vertex, class Pixel, class Index>
+	void DrawToShadowMap(int numIndexGroups, const Index* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader)
+	{
+		PROFILE_SCOPE("Shadow Pass");
+		ShadowPassRenderer().DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, VertexShadowShader, PixelShadowShader);
+	}
+
+	template <class Vertex, class Pixel, class Uniforms, class Index>
+	void DrawToShadowMap(int numIndexGroups, const Index* indices, Vertex* vertices, const Uniforms& uniforms, Renderer::UNIFORM_VS_TYPE<Vertex, Pixel, Uniforms> VertexShadowShader, Renderer::UNIFORM_PS_TYPE<Pixel, Uniforms> PixelShadowShader)
 	{
-		shadowMapRenderer.DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, VertexShadowShader, PixelShadowShader);
+		PROFILE_SCOPE("Shadow Pass");
+		ShadowPassRenderer().DrawElementArray<Vertex, Pixel>(numIndexGroups, indices, vertices, uniforms, VertexShadowShader, PixelShadowShader);
 	}
 
 	float SampleShadowMap(float s, float t) const;
@@ -155,8 +197,8 @@ public:
 
 	void UpdateShadowBox(const Frustum& viewFrustum, const Mat4& camToWorldMatrix);
 
-	template <class Vertex, class Pixel>
-	void DrawToShadowMap(int numIndexGroups, int* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader);
+	template <class Vertex, class Pixel, class Index>
+	void DrawToShadowMap(int numIndexGroups, const Index* indices, Vertex* vertices, Renderer::VS_TYPE<Vertex, Pixel> VertexShadowShader, Renderer::PS_TYPE<Pixel> PixelShadowShader);
 
 	template <class Vertex, class Pixel, class Mesh>
 	void DrawToShadowMap(Mesh* mesh, int numIndexGroups, int* indices, Vertex* vertices);
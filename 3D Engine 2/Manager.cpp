@@ -1,142 +1,377 @@
 #include "Manager.h"
+#include "SwapChain.h"
+#include "Profiler.h"
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <SDL.h>
 #include <iostream>
 
-// true while the front buffer is in process of being copied to the window
-static volatile bool drawing = false;
-
-// true while the renderer is in process of drawing onto the back buffer,
-// and while events are being handled
-static volatile bool rendering = false;
-
-static volatile bool shouldQuit = false;
+// set by whichever thread's callback asks to exit the program
+static std::atomic<bool> shouldQuit(false);
 
 static Window* pWindow = nullptr;
+static SwapChain* pSwapChain = nullptr;
 
-static Surface* pFrontBuffer = nullptr;
-static Surface* pBackBuffer = nullptr;
+// fed by the event handler and by any other thread through PostCommand
+static CommandQueue<Command> commandQueue;
 
 static EventHandler_T pEventHandler;
 static ProgramLogic_T pProgramLogic;
 static PostProcess_T pPostProcess;
 
+void PostCommand(const Command& command) {
+	commandQueue.Enqueue(command);
+}
+
 static void DrawLoop() {
 
-	// while the render loop has not signaled
-	// to exit the program
-	while (!shouldQuit) {
-		
-		drawing = true;
+	PROFILE_THREAD_NAME("Draw Loop");
+
+	// sleeps until the renderer finishes a frame, and
+	// stops when the render loop closes the swap chain
+	while ( pSwapChain->AcquireFront() ) {
+
+		Surface& frontBuffer = pSwapChain->GetFrontBuffer();
 
 		// call the post processing function
-		shouldQuit = pPostProcess(*pFrontBuffer);
+		{
+			PROFILE_SCOPE("Post Processing");
+
+			if ( pPostProcess(frontBuffer) )
+				shouldQuit = true;
+		}
 
 		// draw to the window
-		pWindow->DrawSurface(*pFrontBuffer);
-		drawing = false;
+		PROFILE_SCOPE("Present");
+		pWindow->DrawSurface(frontBuffer);
+	}
+}
+
+// command lists passed between the logic thread and the raster thread
+class CommandListQueue {
+
+private:
+
+	std::deque<Renderer::CommandList*> lists;
+	bool closed = false;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+
+public:
+
+	void Push(Renderer::CommandList* list) {
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			lists.push_back(list);
+		}
+
+		changed.notify_one();
+	}
+
+	// sleeps until there is a list, returns nullptr once closed
+	Renderer::CommandList* Pop() {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !lists.empty() || closed; });
+
+		if (closed)
+			return nullptr;
 
-		// wait for the renderer to finish
-		while ( rendering );
+		Renderer::CommandList* list = lists.front();
+		lists.pop_front();
+
+		return list;
+	}
+
+	void Close() {
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+
+		changed.notify_all();
+	}
+
+};
+
+static void RasterLoop(Renderer* pRenderer, CommandListQueue* pRecorded, CommandListQueue* pFree) {
+
+	PROFILE_THREAD_NAME("Raster Loop");
+
+	Renderer& renderer = *pRenderer;
+
+	while ( Renderer::CommandList* list = pRecorded->Pop() ) {
+
+		PROFILE_SCOPE("Rasterize Frame");
+
+		renderer.ResetStatistics();
+
+		// the list starts with any resizes, then clears the back buffer, then draws
+		renderer.Execute(*list);
+		renderer.ClearDepthBuffer();
+
+		pSwapChain->Publish();
+		renderer.SetRenderTarget(pSwapChain->GetBackBuffer());
+
+		list->Clear();
+		pFree->Push(list);
 	}
 }
 
-void StartDoubleBufferedInstance(Window& window, EventHandler_T eventHandler, ProgramLogic_T programLogic, PostProcess_T postProcessing, short renderFlags)
-{
-	pWindow = &window;
-	pEventHandler = eventHandler;
-	pProgramLogic = programLogic;
-	pPostProcess = postProcessing;
+static void RunPipelined(SwapChain& swapChain, short renderFlags, int pipelineDepth) {
 
-	Surface s1(window.GetWidth() * REL_RES, window.GetHeight() * REL_RES);
-	Surface s2(window.GetWidth() * REL_RES, window.GetHeight() * REL_RES);
+	Renderer::CommandList lists[MAX_PIPELINE_DEPTH];
 
-	Queue<int> commandQueue;
+	// one list is recorded while the others wait for, or are in, the raster thread
+	CommandListQueue freeLists;
+	CommandListQueue recordedLists;
 
-	pFrontBuffer = &s1;
-	pBackBuffer = &s2;
+	for ( int i = 0; i < pipelineDepth; ++i )
+		freeLists.Push(&lists[i]);
 
-	// start the draw loop in a new thread
-	std::thread drawLoop(DrawLoop);
+	Surface& backBuffer = swapChain.GetBackBuffer();
 
-	Renderer renderer(*pBackBuffer);
-	renderer.SetFlags(renderFlags);
+	// draws are recorded on this thread and drawn by the raster thread's renderer
+	Renderer recorder(backBuffer.GetWidth(), backBuffer.GetHeight());
+	recorder.SetFlags(renderFlags);
+
+	Renderer rasterizer(backBuffer);
+
+	std::thread rasterLoop(RasterLoop, &rasterizer, &recordedLists, &freeLists);
 
 	float deltaTime = 0;
 	while ( !shouldQuit ) {
 
 #ifdef DIAGNOSTICS
-		static double totalRenderTime = 0;
+		static double totalRecordTime = 0;
 		static int frames = 0;
 		static double totalTime = 0;
 #endif
 
 		Uint64 start = SDL_GetPerformanceCounter();
 
-		//////////////////////// START RENDER BLOCK /////////////////////////////
-		rendering = true;
-
-		//clear the buffer about to be drawn to
-		pBackBuffer->BlackOut();
-
-		// call the program and render logic
-		shouldQuit = pProgramLogic(renderer, deltaTime);
-
-		renderer.ClearDepthBuffer();
+		// waits here when the raster thread is pipelineDepth frames behind
+		Renderer::CommandList* list;
+		{
+			PROFILE_SCOPE("Wait For Raster");
+			list = freeLists.Pop();
+		}
 
 #ifdef DIAGNOSTICS
-		Uint64 renderEnd = SDL_GetPerformanceCounter();
-		totalRenderTime += (renderEnd - start) / (double)SDL_GetPerformanceFrequency();
+		Uint64 recordStart = SDL_GetPerformanceCounter();
 #endif
 
-		// if drawing is not done, it is taking longer than render
-		// wait for drawing to finish before swapping the buffers,
-
-		while ( drawing );
-
-		// swap the buffers
-		std::swap(pFrontBuffer, pBackBuffer);
-		renderer.SetRenderTarget(*pBackBuffer);
+		// handle events first, so their commands go in front of this frame's draws
+		{
+			PROFILE_SCOPE("Events");
 
-		// handle events before drawing or rendering
-		// can start up again
-		shouldQuit = pEventHandler(commandQueue);
+			if ( pEventHandler(commandQueue) )
+				shouldQuit = true;
+		}
 
 		// process all commands in the command queue
-		while ( !commandQueue.IsEmpty() ) {
-
-			int commandId = commandQueue.Dequeue();
+		commandQueue.Drain([&](const Command& command) {
 
-			switch ( commandId ) {
+			switch ( command.type ) {
 
 			case C_RESIZE:
 			{
-				// width and height should be the next 2 values in the queue
-				int newWidth = commandQueue.Dequeue();
-				int newHeight = commandQueue.Dequeue();
+				int newWidth = command.width;
+				int newHeight = command.height;
+
+				// the buffers belong to the raster thread, so it resizes them
+				// when it reaches this frame
+				recorder.GetDepthBuffer().Resize(newWidth, newHeight);
 
-				// need to resize both buffers and the renderer's depth buffer
-				pFrontBuffer->Resize(newWidth, newHeight, false);
-				pBackBuffer->Resize(newWidth, newHeight, false);
-				renderer.GetDepthBuffer().Resize(newWidth, newHeight);
+				list->Record([newWidth, newHeight](Renderer& renderer) {
+					pSwapChain->Resize(newWidth, newHeight);
+					renderer.GetDepthBuffer().Resize(newWidth, newHeight);
+				});
 
 				break;
 			}
 			case C_SET_FLAG:
-				renderer.SetFlags(commandQueue.Dequeue());
+				recorder.SetFlags(command.flags);
 				break;
 			case C_CLEAR_FLAG:
-				renderer.ClearFlags(commandQueue.Dequeue());
+				recorder.ClearFlags(command.flags);
 				break;
 			case C_TOGGLE_FLAG:
-				renderer.ToggleFlags(commandQueue.Dequeue());
+				recorder.ToggleFlags(command.flags);
 				break;
 
 			}
 
+		});
+
+		//clear the buffer about to be drawn to
+		list->Record([](Renderer& renderer) {
+			renderer.GetRenderTarget().BlackOut();
+		});
+
+		// call the program logic, its draws are recorded into the list
+		recorder.ResetStatistics();
+		recorder.BeginRecording(*list);
+
+		{
+			PROFILE_SCOPE("Program Logic");
+
+			if ( pProgramLogic(recorder, deltaTime) )
+				shouldQuit = true;
+		}
+
+		recorder.EndRecording();
+
+#ifdef DIAGNOSTICS
+		totalRecordTime += (SDL_GetPerformanceCounter() - recordStart) / (double)SDL_GetPerformanceFrequency();
+#endif
+
+		recordedLists.Push(list);
+
+		Uint64 end = SDL_GetPerformanceCounter();
+		static Uint64 interval = SDL_GetPerformanceFrequency();
+
+		deltaTime = (end - start) / (float)interval;
+
+#ifdef DIAGNOSTICS
+		totalTime += deltaTime;
+		frames++;
+
+		if ( totalTime > 1.0 ) {
+			std::cout << "Frame Time: " << totalTime * 1000 / frames << " ms.   "
+				<< frames << " frames.   " << totalRecordTime * 1000 / frames
+				<< " ms logic and vertex time.   (" << (int)(totalRecordTime * 100 / totalTime) << "%)"
+				<< std::endl;
+			frames = 0;
+			totalTime = 0;
+			totalRecordTime = 0;
+		}
+#endif
+
+	}
+
+	// frames still waiting in the pipeline are dropped
+	recordedLists.Close();
+	rasterLoop.join();
+}
+
+void StartDoubleBufferedInstance(Window& window, EventHandler_T eventHandler, ProgramLogic_T programLogic, PostProcess_T postProcessing, short renderFlags, int pipelineDepth)
+{
+	pWindow = &window;
+	pEventHandler = eventHandler;
+	pProgramLogic = programLogic;
+	pPostProcess = postProcessing;
+
+	shouldQuit = false;
+
+	SwapChain swapChain(window.GetWidth() * REL_RES, window.GetHeight() * REL_RES);
+	pSwapChain = &swapChain;
+
+	// start the draw loop in a new thread
+	std::thread drawLoop(DrawLoop);
+
+	if ( pipelineDepth > 1 ) {
+
+		PROFILE_THREAD_NAME("Logic Loop");
+
+		RunPipelined(swapChain, renderFlags, std::min(pipelineDepth, MAX_PIPELINE_DEPTH));
+
+		swapChain.Close();
+		drawLoop.join();
+
+		pSwapChain = nullptr;
+
+		PROFILE_SAVE(PROFILER_TRACE_FILE);
+		return;
+	}
+
+	PROFILE_THREAD_NAME("Render Loop");
+
+	Renderer renderer(swapChain.GetBackBuffer());
+	renderer.SetFlags(renderFlags);
+
+	float deltaTime = 0;
+	while ( !shouldQuit ) {
+
+#ifdef DIAGNOSTICS
+		static double totalRenderTime = 0;
+		static int frames = 0;
+		static double totalTime = 0;
+#endif
+
+		Uint64 start = SDL_GetPerformanceCounter();
+
+		//////////////////////// START RENDER BLOCK /////////////////////////////
+
+		renderer.ResetStatistics();
+
+		//clear the buffer about to be drawn to
+		{
+			PROFILE_SCOPE("Clear");
+			swapChain.GetBackBuffer().BlackOut();
+		}
+
+		// call the program and render logic
+		{
+			PROFILE_SCOPE("Program Logic");
+
+			if ( pProgramLogic(renderer, deltaTime) )
+				shouldQuit = true;
+		}
+
+		{
+			PROFILE_SCOPE("Clear Depth");
+			renderer.ClearDepthBuffer();
+		}
+
+#ifdef DIAGNOSTICS
+		Uint64 renderEnd = SDL_GetPerformanceCounter();
+		totalRenderTime += (renderEnd - start) / (double)SDL_GetPerformanceFrequency();
+#endif
+
+		// hand the frame to the draw loop, this never waits for drawing to finish
+		swapChain.Publish();
+		renderer.SetRenderTarget(swapChain.GetBackBuffer());
+
+		// handle events before rendering starts up again
+		{
+			PROFILE_SCOPE("Events");
+
+			if ( pEventHandler(commandQueue) )
+				shouldQuit = true;
+
+			// process all commands in the command queue
+			commandQueue.Drain([&](const Command& command) {
+
+				switch ( command.type ) {
+
+				case C_RESIZE:
+					// the draw loop may be using the other buffers, they are
+					// resized as they come back from it
+					swapChain.Resize(command.width, command.height);
+					renderer.GetDepthBuffer().Resize(command.width, command.height);
+					break;
+				case C_SET_FLAG:
+					renderer.SetFlags(command.flags);
+					break;
+				case C_CLEAR_FLAG:
+					renderer.ClearFlags(command.flags);
+					break;
+				case C_TOGGLE_FLAG:
+					renderer.ToggleFlags(command.flags);
+					break;
+
+				}
+
+			});
 		}
 
-		rendering = false;
 		/////////////////////////// END RENDER BLOCK ////////////////////////////
 
 		Uint64 end = SDL_GetPerformanceCounter();
@@ -162,5 +397,77 @@ void StartDoubleBufferedInstance(Window& window, EventHandler_T eventHandler, Pr
 
 	}
 
+	swapChain.Close();
 	drawLoop.join();
+
+	pSwapChain = nullptr;
+
+	PROFILE_SAVE(PROFILER_TRACE_FILE);
+}
+
+int StartHeadlessInstance(int width, int height, ProgramLogic_T programLogic, PostProcess_T postProcessing, FrameSink_T frameSink, short renderFlags, int numFrames, float fixedDeltaTime)
+{
+	PROFILE_THREAD_NAME("Headless Loop");
+
+	Surface frame(width, height);
+
+	Renderer renderer(frame);
+	renderer.SetFlags(renderFlags);
+
+	// the performance counter works without initializing SDL
+	Uint64 interval = SDL_GetPerformanceFrequency();
+	Uint64 firstStart = SDL_GetPerformanceCounter();
+
+	float deltaTime = fixedDeltaTime;
+	bool quit = false;
+
+	int frameNumber = 0;
+	while ( !quit && (numFrames == 0 || frameNumber < numFrames) ) {
+
+		Uint64 start = SDL_GetPerformanceCounter();
+
+		PROFILE_SCOPE("Frame");
+
+		renderer.ResetStatistics();
+
+		{
+			PROFILE_SCOPE("Clear");
+			frame.BlackOut();
+		}
+
+		{
+			PROFILE_SCOPE("Program Logic");
+			quit = programLogic(renderer, deltaTime);
+		}
+
+		renderer.ClearDepthBuffer();
+
+		if ( postProcessing != nullptr ) {
+			PROFILE_SCOPE("Post Processing");
+			quit |= postProcessing(frame);
+		}
+
+		if ( frameSink != nullptr ) {
+			PROFILE_SCOPE("Frame Sink");
+			quit |= frameSink(frame, frameNumber);
+		}
+
+		++frameNumber;
+
+		if ( fixedDeltaTime <= 0 )
+			deltaTime = (SDL_GetPerformanceCounter() - start) / (float)interval;
+	}
+
+#ifdef DIAGNOSTICS
+	double totalTime = (SDL_GetPerformanceCounter() - firstStart) / (double)interval;
+
+	if ( frameNumber > 0 )
+		std::cout << "Headless: " << frameNumber << " frames in " << totalTime * 1000 << " ms.   "
+			<< totalTime * 1000 / frameNumber << " ms per frame.   "
+			<< frameNumber / totalTime << " frames per second." << std::endl;
+#endif
+
+	PROFILE_SAVE(PROFILER_TRACE_FILE);
+
+	return frameNumber;
 }
@@ -2,11 +2,13 @@
 #include "Window.h"
 #include "Surface.h"
 #include "Renderer.h"
-#include "Queue.h"
+#include "CommandQueue.h"
 
 #define REL_RES 1
 #define DIAGNOSTICS
 
+#define MAX_PIPELINE_DEPTH 4
+
 enum Commands {
 
 	C_RESIZE,
@@ -16,15 +18,62 @@ enum Commands {
 
 };
 
+// one request for the render loop, which fields are used depends on type
+struct Command {
+
+	int type;
+
+	// C_RESIZE
+	int width;
+	int height;
+
+	// C_SET_FLAG, C_CLEAR_FLAG and C_TOGGLE_FLAG
+	short flags;
+
+};
+
 // types for function callbacks
-using EventHandler_T = bool (*)(Queue<int>& commandQueue);
+using EventHandler_T = bool (*)(CommandQueue<Command>& commandQueue);
 using ProgramLogic_T = bool (*)(Renderer & renderer, float deltaTime);
 using PostProcess_T = bool (*)(Surface & frontBuffer);
 
+// receives each finished frame of a headless instance, returning true stops it
+using FrameSink_T = bool (*)(const Surface & frame, int frameNumber);
+
+// sends a command to the running instance from any thread, it is applied before
+// the next frame starts, or before the next frame is recorded when pipelined
+void PostCommand(const Command& command);
+
+// pipelineDepth is how many frames can be between ProgramLogic and the window.
+// at 1 each frame's logic and rasterization run back to back on this thread.
+// above 1, ProgramLogic only records its draws, running their vertex shaders,
+// while a raster thread draws the frames recorded before it. throughput goes up,
+// but each frame is shown up to pipelineDepth - 1 frames later, and anything the
+// pixel shaders read must not change until the frame has been rasterized,
+// Renderer::RunInOrder and the lights' BeginShadowPass exist for that
 void StartDoubleBufferedInstance(
 	Window& window,
 	EventHandler_T eventHandler,
 	ProgramLogic_T programLogic, 
 	PostProcess_T postProcessing, 
-	short renderFlags
-);
\ No newline at end of file
+	short renderFlags,
+	int pipelineDepth = 1
+);
+
+// renders into offscreen surfaces, without a window or SDL video, so it can run
+// on servers and in benchmarks. stops after numFrames, or runs until a callback
+// returns true if numFrames is 0. a fixedDeltaTime above 0 is passed to every
+// frame instead of the measured frame time, so runs are repeatable.
+// it only uses SDL for its timer, but the tree is still only built with MSVC through
+// the Visual Studio project, so other platforms need their own build of it.
+// returns the number of frames rendered
+int StartHeadlessInstance(
+	int width,
+	int height,
+	ProgramLogic_T programLogic,
+	PostProcess_T postProcessing,
+	FrameSink_T frameSink,
+	short renderFlags,
+	int numFrames,
+	float fixedDeltaTime = 0
+);
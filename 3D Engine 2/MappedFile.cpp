@@ -0,0 +1,147 @@
+#include "MappedFile.h"
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {}
+
+MappedFile::MappedFile(const std::string& filepath, bool copyOnWrite) {
+	Open(filepath, copyOnWrite);
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filepath, bool copyOnWrite) {
+
+	Close();
+
+#ifdef _WIN32
+
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = view;
+	size = (size_t)fileSize.QuadPart;
+
+#else
+
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	// private mappings never write back to the file
+	void* view = mmap(nullptr, info.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	fileDescriptor = fd;
+	data = view;
+	size = (size_t)info.st_size;
+
+#endif
+
+	writable = copyOnWrite;
+
+	return true;
+
+}
+
+void MappedFile::Close() {
+
+	if (data == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(data, size);
+	close(fileDescriptor);
+
+	fileDescriptor = -1;
+#endif
+
+	data = nullptr;
+	size = 0;
+	writable = false;
+
+}
+
+bool MappedFile::IsOpen() const {
+	return data != nullptr;
+}
+
+const void* MappedFile::Data() const {
+	return data;
+}
+
+void* MappedFile::MutableData() {
+	return writable ? data : nullptr;
+}
+
+size_t MappedFile::Size() const {
+	return size;
+}
+
+bool GetFileStamp(const std::string& filepath, long long& size, long long& modified) {
+
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(filepath.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(filepath.c_str(), &info) != 0)
+		return false;
+#endif
+
+	size = (long long)info.st_size;
+	modified = (long long)info.st_mtime;
+
+	return true;
+
+}
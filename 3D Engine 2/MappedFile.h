@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <stddef.h>
+
+// View of a whole file mapped into memory.
+// Pages are loaded by the OS as they are touched, so opening is cheap
+// and nothing is copied until the data is actually read.
+// A copy on write mapping can be modified, the OS copies each page the
+// first time it is written to and the file itself never changes.
+class MappedFile {
+
+private:
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	void* data = nullptr;
+	bool writable = false;
+	size_t size = 0;
+
+public:
+
+	MappedFile();
+	MappedFile(const std::string& filepath, bool copyOnWrite = false);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// unmaps any file already open, returns false if the file could not be mapped
+	bool Open(const std::string& filepath, bool copyOnWrite = false);
+	void Close();
+
+	bool IsOpen() const;
+
+	const void* Data() const;
+
+	// only for copy on write mappings, null otherwise
+	void* MutableData();
+	size_t Size() const;
+
+};
+
+// size in bytes and last modification time of a file, used to tell if
+// a file generated from it is out of date, returns false if the file does not exist
+bool GetFileStamp(const std::string& filepath, long long& size, long long& modified);
@@ -6,6 +6,15 @@
 
 #define PI 3.14159265358979323846
 
+// m * v as a sum of the columns scaled by each component, no horizontal adds
+static inline __m128 Transform(const __m128 cols[4], __m128 v) {
+
+	__m128 xy = _mm_add_ps(_mm_mul_ps(cols[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))), _mm_mul_ps(cols[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+	__m128 zw = _mm_add_ps(_mm_mul_ps(cols[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))), _mm_mul_ps(cols[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+	return _mm_add_ps(xy, zw);
+}
+
 const Mat4 Mat4::Identity{ 
 	{ 1, 0, 0, 0 }, 
 	{ 0, 1, 0, 0 }, 
@@ -76,53 +85,39 @@ Vec4 Mat4::operator[](int c) const {
 
 Mat4 Mat4::operator*(const Mat4& m) const {
 
-	union vec { __m128 sse; float arr[4]; };
+	__m128 thisCols[4] = { _mm_loadu_ps(data), _mm_loadu_ps(data + 4), _mm_loadu_ps(data + 8), _mm_loadu_ps(data + 12) };
 
-	// data gets reversed when inserting manually
-	vec thisRows[4];
-	thisRows[0].sse = _mm_set_ps(data[12], data[8], data[4], data[0]);
-	thisRows[1].sse = _mm_set_ps(data[13], data[9], data[5], data[1]);
-	thisRows[2].sse = _mm_set_ps(data[14], data[10], data[6], data[2]);
-	thisRows[3].sse = _mm_set_ps(data[15], data[11], data[7], data[3]);
+	// each column of the product is this matrix times that column of m
+	Mat4 product;
 
-	Vec4 newCols[4];
-	float* ptr = (float*)newCols;
+	for (int i = 0; i < 4; ++i)
+		_mm_storeu_ps(product.data + i * 4, Transform(thisCols, _mm_loadu_ps(m.data + i * 4)));
 
-	for (int i = 0; i < 4; ++i) {
+	return product;
 
-		vec otherCol;
-		otherCol.sse = _mm_load_ps((const float*)&m.cols[i]);
+}
 
-		for (int j = 0; j < 4; ++j) {
+Vec4 Mat4::operator*(const Vec4& v) const {
 
-			vec product;
-			product.sse = _mm_mul_ps(thisRows[j].sse, otherCol.sse);
+	__m128 thisCols[4] = { _mm_loadu_ps(data), _mm_loadu_ps(data + 4), _mm_loadu_ps(data + 8), _mm_loadu_ps(data + 12) };
 
-			float sum = (product.arr[0] + product.arr[1]) + (product.arr[2] + product.arr[3]);
+	Vec4 result;
+	_mm_storeu_ps(&result.x, Transform(thisCols, _mm_loadu_ps(&v.x)));
 
-			*ptr = sum;
-			ptr++;
-		}
-	}
-	
-	return { newCols[0], newCols[1], newCols[2], newCols[3] };
+	return result;
 
 }
 
-Vec4 Mat4::operator*(const Vec4& v) const {
+Mat4 Mat4::operator*(float c) const {
 
-	Vec4 thisRow1(data[0], data[4], data[8], data[12]);
-	Vec4 thisRow2(data[1], data[5], data[9], data[13]);
-	Vec4 thisRow3(data[2], data[6], data[10], data[14]);
-	Vec4 thisRow4(data[3], data[7], data[11], data[15]);
+	__m128 scale = _mm_set1_ps(c);
 
-	return { thisRow1 * v, thisRow2 * v, thisRow3 * v, thisRow4 * v };
+	Mat4 product;
 
-}
+	for (int i = 0; i < 16; i += 4)
+		_mm_storeu_ps(product.data + i, _mm_mul_ps(_mm_loadu_ps(data + i), scale));
 
-Mat4 Mat4::operator*(float c) const {
-
-	return { cols[0] * c, cols[1] * c, cols[2] * c, cols[3] * c };
+	return product;
 
 }
 
@@ -187,8 +182,58 @@ static inline void SwapRow(row& row1, row& row2) {
 
 }
 
+static inline __m128 Cross(__m128 a, __m128 b) {
+
+	__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+
+	// a * b.yzx - a.yzx * b comes out as the cross product in yzx order
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// the inverse of rotation, scale and translation only matrices, the bottom row
+// must be 0, 0, 0, 1. the rows of the inverse 3x3 are cross products of its columns
+static Mat4 AffineInverse(const float* data) {
+
+	__m128 a = _mm_loadu_ps(data);
+	__m128 b = _mm_loadu_ps(data + 4);
+	__m128 c = _mm_loadu_ps(data + 8);
+	__m128 t = _mm_loadu_ps(data + 12);
+
+	__m128 r0 = Cross(b, c);
+	__m128 r1 = Cross(c, a);
+	__m128 r2 = Cross(a, b);
+	__m128 r3 = _mm_setzero_ps();
+
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1), _mm_dp_ps(a, r0, 0x7f));
+
+	r0 = _mm_mul_ps(r0, invDet);
+	r1 = _mm_mul_ps(r1, invDet);
+	r2 = _mm_mul_ps(r2, invDet);
+
+	// the rows become columns, with the w row zero
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	// the translation is undone after the rotation and scale are
+	__m128 cols[4] = { r0, r1, r2, _mm_setzero_ps() };
+	__m128 translation = _mm_sub_ps(_mm_setzero_ps(), Transform(cols, t));
+
+	Vec4 inverse[4];
+	_mm_storeu_ps(&inverse[0].x, r0);
+	_mm_storeu_ps(&inverse[1].x, r1);
+	_mm_storeu_ps(&inverse[2].x, r2);
+	_mm_storeu_ps(&inverse[3].x, _mm_blend_ps(translation, _mm_set1_ps(1), 0x8));
+
+	return { inverse[0], inverse[1], inverse[2], inverse[3] };
+}
+
 Mat4 Mat4::GetInverse() const {
 
+	// model and view matrices skip the general elimination
+	if (data[3] == 0 && data[7] == 0 && data[11] == 0 && data[15] == 1)
+		return AffineInverse(data);
+
 	row row0, inverse0;
 	row row1, inverse1;
 	row row2, inverse2;
@@ -250,13 +295,21 @@ Mat4 Mat4::GetInverse() const {
 }
 
 Mat4 Mat4::GetTranspose() const {
-	return
-	{
-		{data[0], data[4], data[8], data[12]},
-		{data[1], data[5], data[9], data[13]},
-		{data[2], data[6], data[10], data[14]},
-	    {data[3], data[7], data[11], data[15]}
-	};
+
+	__m128 c0 = _mm_loadu_ps(data);
+	__m128 c1 = _mm_loadu_ps(data + 4);
+	__m128 c2 = _mm_loadu_ps(data + 8);
+	__m128 c3 = _mm_loadu_ps(data + 12);
+
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	Mat4 transpose;
+	_mm_storeu_ps(transpose.data, c0);
+	_mm_storeu_ps(transpose.data + 4, c1);
+	_mm_storeu_ps(transpose.data + 8, c2);
+	_mm_storeu_ps(transpose.data + 12, c3);
+
+	return transpose;
 }
 
 Mat3 Mat4::Truncate() const {
@@ -275,18 +328,14 @@ Mat4 Mat4::Get3DTranslation(float dx, float dy, float dz) {
 }
 Mat4 Mat4::GetRotation(float rx, float ry, float rz) {
 
-	union vec { __m128 sse; float arr[4]; };
-
-	__m128 data = _mm_set_ps(0, rz, ry, rx);
-
 	// calculate sin and cos of each rotation value
-	vec sins, coss;
-	sins.sse = _mm_sin_ps(data);
-	coss.sse = _mm_cos_ps(data);
+	// sinf and cosf instead of the SVML intrinsics, which only MSVC provides
+	float sins[3] = { sinf(rx), sinf(ry), sinf(rz) };
+	float coss[3] = { cosf(rx), cosf(ry), cosf(rz) };
 
-	Mat4 matX({ 1, 0, 0, 0 }, { 0, coss.arr[0], sins.arr[0], 0 }, { 0, -sins.arr[0], coss.arr[0], 0 }, {0, 0, 0, 1});
-	Mat4 matY({ coss.arr[1], 0, -sins.arr[1], 0 }, { 0, 1, 0, 0 }, { sins.arr[1], 0, coss.arr[1], 0 }, {0, 0, 0, 1});
-	Mat4 matZ({ coss.arr[2], sins.arr[2], 0, 0 }, { -sins.arr[2], coss.arr[2], 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 });
+	Mat4 matX({ 1, 0, 0, 0 }, { 0, coss[0], sins[0], 0 }, { 0, -sins[0], coss[0], 0 }, {0, 0, 0, 1});
+	Mat4 matY({ coss[1], 0, -sins[1], 0 }, { 0, 1, 0, 0 }, { sins[1], 0, coss[1], 0 }, {0, 0, 0, 1});
+	Mat4 matZ({ coss[2], sins[2], 0, 0 }, { -sins[2], coss[2], 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 });
 
 	return matZ * matY * matX;
 }
@@ -338,6 +387,69 @@ Mat4 Mat4::GetOrthographicProjection(float n, float f, float l, float r, float t
 
 }
 
+void TransformPoints(const Mat4& m, const Vec4* in, Vec4* out, int n) {
+
+	// every coefficient in its own register, coefficients[r][c] is m(r, c)
+	__m256 coefficients[4][4];
+
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			coefficients[r][c] = _mm256_set1_ps(m(r, c));
+
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+
+		const float* source = &in[i].x;
+
+		// two points per register
+		__m256 p01 = _mm256_loadu_ps(source);
+		__m256 p23 = _mm256_loadu_ps(source + 8);
+		__m256 p45 = _mm256_loadu_ps(source + 16);
+		__m256 p67 = _mm256_loadu_ps(source + 24);
+
+		// transpose to one register per component, the points end up in
+		// the order 0 2 4 6 1 3 5 7, which the transpose back undoes
+		__m256 xy0 = _mm256_unpacklo_ps(p01, p23);
+		__m256 zw0 = _mm256_unpackhi_ps(p01, p23);
+		__m256 xy1 = _mm256_unpacklo_ps(p45, p67);
+		__m256 zw1 = _mm256_unpackhi_ps(p45, p67);
+
+		__m256 v[4];
+		v[0] = _mm256_shuffle_ps(xy0, xy1, _MM_SHUFFLE(1, 0, 1, 0));
+		v[1] = _mm256_shuffle_ps(xy0, xy1, _MM_SHUFFLE(3, 2, 3, 2));
+		v[2] = _mm256_shuffle_ps(zw0, zw1, _MM_SHUFFLE(1, 0, 1, 0));
+		v[3] = _mm256_shuffle_ps(zw0, zw1, _MM_SHUFFLE(3, 2, 3, 2));
+
+		__m256 result[4];
+
+		for (int r = 0; r < 4; ++r) {
+
+			__m256 xy = _mm256_add_ps(_mm256_mul_ps(coefficients[r][0], v[0]), _mm256_mul_ps(coefficients[r][1], v[1]));
+			__m256 zw = _mm256_add_ps(_mm256_mul_ps(coefficients[r][2], v[2]), _mm256_mul_ps(coefficients[r][3], v[3]));
+
+			result[r] = _mm256_add_ps(xy, zw);
+		}
+
+		// back to one point per 4 floats
+		__m256 xy2 = _mm256_unpacklo_ps(result[0], result[1]);
+		__m256 xy3 = _mm256_unpackhi_ps(result[0], result[1]);
+		__m256 zw2 = _mm256_unpacklo_ps(result[2], result[3]);
+		__m256 zw3 = _mm256_unpackhi_ps(result[2], result[3]);
+
+		float* destination = &out[i].x;
+
+		_mm256_storeu_ps(destination, _mm256_shuffle_ps(xy2, zw2, _MM_SHUFFLE(1, 0, 1, 0)));
+		_mm256_storeu_ps(destination + 8, _mm256_shuffle_ps(xy2, zw2, _MM_SHUFFLE(3, 2, 3, 2)));
+		_mm256_storeu_ps(destination + 16, _mm256_shuffle_ps(xy3, zw3, _MM_SHUFFLE(1, 0, 1, 0)));
+		_mm256_storeu_ps(destination + 24, _mm256_shuffle_ps(xy3, zw3, _MM_SHUFFLE(3, 2, 3, 2)));
+	}
+
+	for (; i < n; ++i)
+		out[i] = m * in[i];
+
+}
+
 std::ostream& operator<<(std::ostream& os, const Mat4& m) {
 
 	os << "[ " << m.data[0] << " " << m.data[4] << " " << m.data[8] << " " << m.data[12] << " ]" << std::endl;
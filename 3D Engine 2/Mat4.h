@@ -57,5 +57,9 @@ public:
 
 std::ostream& operator<<(std::ostream& os, const Mat4& dt);
 
+// out[i] = m * in[i] for n points, transposed to x, y, z and w registers and
+// done 8 points at a time with AVX. in and out may be the same array
+void TransformPoints(const Mat4& m, const Vec4* in, Vec4* out, int n);
+
 
 
@@ -0,0 +1,297 @@
+#include "MeshCache.h"
+#include "Importing.h"
+#include <fstream>
+#include <vector>
+#include <chrono>
+
+void CachedMesh::GetLODs(LODChain& lods) const
+{
+	lods.Reset(center, radius);
+
+	const int* levelIndices = indices;
+
+	for ( int level = 0; level < numLevels; ++level ) {
+
+		lods.AddLevel(levelIndices, levels[level].numTriangles, levels[level].error);
+		levelIndices += levels[level].numTriangles * 3;
+	}
+}
+
+// the mesh's arrays must lie inside the file, its levels must fit in its
+// indices and every index must name one of its vertices
+static bool ValidEntry(const char* base, size_t size, const MeshCacheEntry& entry)
+{
+	if ( entry.numVertices < 0 || entry.numLevels < 0 || entry.numIndices < 0 )
+		return false;
+
+	long long floatsPerVertex = 3;
+	if ( entry.flags & MESH_CACHE_NORMALS )
+		floatsPerVertex += 3;
+	if ( entry.flags & MESH_CACHE_TEXCOORDS )
+		floatsPerVertex += 2;
+
+	long long vertexBytes = entry.numVertices * floatsPerVertex * sizeof(float);
+
+	long long bytes = vertexBytes +
+		(long long)entry.numLevels * sizeof(MeshCacheLevel) +
+		(long long)entry.numIndices * sizeof(int);
+
+	if ( entry.offset % 4 != 0 || entry.offset < 0 || entry.offset + bytes > (long long)size )
+		return false;
+
+	const MeshCacheLevel* levels = (const MeshCacheLevel*)(base + entry.offset + vertexBytes);
+	const int* indices = (const int*)(levels + entry.numLevels);
+
+	long long levelIndices = 0;
+	for ( int level = 0; level < entry.numLevels; ++level ) {
+
+		if ( levels[level].numTriangles < 0 )
+			return false;
+
+		levelIndices += levels[level].numTriangles * 3LL;
+	}
+
+	if ( levelIndices > entry.numIndices )
+		return false;
+
+	for ( int i = 0; i < entry.numIndices; ++i )
+		if ( indices[i] < 0 || indices[i] >= entry.numVertices )
+			return false;
+
+	return true;
+}
+
+MeshCache::MeshCache() {}
+
+std::string MeshCache::CachePath(const std::string& sourcePath)
+{
+	return sourcePath + MESH_CACHE_EXTENSION;
+}
+
+bool MeshCache::Load(const std::string& sourcePath, int numLODs)
+{
+	std::string cachePath = CachePath(sourcePath);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if ( Open(cachePath, sourcePath) ) {
+
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << "Mapped " << cachePath << " in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+		return true;
+	}
+
+	std::cout << "Building " << cachePath << std::endl;
+
+	// scope the scene so the assimp data is freed before mapping
+	{
+		Scene scene(sourcePath, numLODs);
+
+		if ( scene.NumMeshes() == 0 )
+			return false;
+
+		if ( !Write(cachePath, sourcePath, scene) ) {
+			std::cout << "Could not write " << cachePath << std::endl;
+			return false;
+		}
+	}
+
+	return Open(cachePath, sourcePath);
+}
+
+bool MeshCache::Open(const std::string& cachePath, const std::string& sourcePath)
+{
+	Close();
+
+	long long sourceSize, sourceModified;
+	if ( !GetFileStamp(sourcePath, sourceSize, sourceModified) )
+		return false;
+
+	if ( !file.Open(cachePath) )
+		return false;
+
+	const char* base = (const char*)file.Data();
+	size_t size = file.Size();
+
+	const MeshCacheHeader* h = (const MeshCacheHeader*)base;
+
+	bool valid = size >= sizeof(MeshCacheHeader) &&
+		h->magic == MESH_CACHE_MAGIC &&
+		h->version == MESH_CACHE_VERSION &&
+		h->sourceSize == sourceSize &&
+		h->sourceModified == sourceModified &&
+		h->numMeshes >= 0 &&
+		size >= sizeof(MeshCacheHeader) + h->numMeshes * sizeof(MeshCacheEntry);
+
+	const MeshCacheEntry* e = (const MeshCacheEntry*)(base + sizeof(MeshCacheHeader));
+
+	// a truncated or corrupt file is rejected here, so Load rebuilds it from the source
+	for ( int m = 0; valid && m < h->numMeshes; ++m )
+		valid = ValidEntry(base, size, e[m]);
+
+	if ( !valid ) {
+		file.Close();
+		return false;
+	}
+
+	header = h;
+	entries = e;
+
+	return true;
+}
+
+void MeshCache::Close()
+{
+	file.Close();
+
+	header = nullptr;
+	entries = nullptr;
+}
+
+int MeshCache::NumMeshes() const
+{
+	return header ? header->numMeshes : 0;
+}
+
+CachedMesh MeshCache::MeshAt(int meshIndex) const
+{
+	const MeshCacheEntry& entry = entries[meshIndex];
+	const float* data = (const float*)((const char*)file.Data() + entry.offset);
+
+	CachedMesh mesh;
+	mesh.numVertices = entry.numVertices;
+
+	mesh.positions = data;
+	data += entry.numVertices * 3;
+
+	mesh.normals = nullptr;
+	if ( entry.flags & MESH_CACHE_NORMALS ) {
+		mesh.normals = data;
+		data += entry.numVertices * 3;
+	}
+
+	mesh.texCoords = nullptr;
+	if ( entry.flags & MESH_CACHE_TEXCOORDS ) {
+		mesh.texCoords = data;
+		data += entry.numVertices * 2;
+	}
+
+	mesh.bounds = {
+		{ entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2] },
+		{ entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2] }
+	};
+
+	mesh.center = { entry.center[0], entry.center[1], entry.center[2] };
+	mesh.radius = entry.radius;
+
+	mesh.numLevels = entry.numLevels;
+	mesh.levels = (const MeshCacheLevel*)data;
+	mesh.indices = (const int*)(mesh.levels + entry.numLevels);
+
+	return mesh;
+}
+
+bool MeshCache::Write(const std::string& cachePath, const std::string& sourcePath, const Scene& scene)
+{
+	MeshCacheHeader h = {};
+	if ( !GetFileStamp(sourcePath, h.sourceSize, h.sourceModified) )
+		return false;
+
+	h.version = MESH_CACHE_VERSION;
+	h.numMeshes = scene.NumMeshes();
+
+	std::vector<MeshCacheEntry> e(h.numMeshes);
+
+	// everything that goes after the entries
+	std::vector<char> body;
+
+	auto Append = [&body](const void* data, size_t bytes) {
+		body.insert(body.end(), (const char*)data, (const char*)data + bytes);
+	};
+
+	long long bodyStart = sizeof(MeshCacheHeader) + h.numMeshes * sizeof(MeshCacheEntry);
+
+	for ( int m = 0; m < h.numMeshes; ++m ) {
+
+		Mesh mesh = scene.MeshAt(m);
+		const LODChain& lods = mesh.LODs();
+
+		MeshCacheEntry& entry = e[m];
+		entry = {};
+
+		entry.numVertices = mesh.NumVertices();
+		entry.numLevels = lods.NumLevels();
+		entry.offset = bodyStart + body.size();
+
+		if ( mesh.HasNormals() )
+			entry.flags |= MESH_CACHE_NORMALS;
+		if ( mesh.HasTextureCoords() )
+			entry.flags |= MESH_CACHE_TEXCOORDS;
+
+		std::vector<float> floats;
+		floats.reserve(entry.numVertices * 8);
+
+		AABB bounds = {};
+
+		for ( int v = 0; v < entry.numVertices; ++v ) {
+
+			Vec3 p = mesh.Positions(v);
+			floats.insert(floats.end(), { p.x, p.y, p.z });
+
+			bounds = v == 0 ? AABB{ p, p } : bounds.Union({ p, p });
+		}
+
+		if ( entry.flags & MESH_CACHE_NORMALS ) {
+			for ( int v = 0; v < entry.numVertices; ++v ) {
+
+				Vec3 n = mesh.Normals(v);
+				floats.insert(floats.end(), { n.x, n.y, n.z });
+			}
+		}
+
+		if ( entry.flags & MESH_CACHE_TEXCOORDS ) {
+			for ( int v = 0; v < entry.numVertices; ++v ) {
+
+				Vec2 t = mesh.TextureCoords(v);
+				floats.insert(floats.end(), { t.x, t.y });
+			}
+		}
+
+		Append(floats.data(), floats.size() * sizeof(float));
+
+		entry.boundsMin[0] = bounds.min.x; entry.boundsMin[1] = bounds.min.y; entry.boundsMin[2] = bounds.min.z;
+		entry.boundsMax[0] = bounds.max.x; entry.boundsMax[1] = bounds.max.y; entry.boundsMax[2] = bounds.max.z;
+
+		const Vec3& center = lods.GetCenter();
+		entry.center[0] = center.x; entry.center[1] = center.y; entry.center[2] = center.z;
+		entry.radius = lods.GetRadius();
+
+		for ( int level = 0; level < lods.NumLevels(); ++level ) {
+
+			MeshCacheLevel l = { lods.NumTriangles(level), lods.GetError(level) };
+			Append(&l, sizeof(l));
+		}
+
+		for ( int level = 0; level < lods.NumLevels(); ++level ) {
+
+			Append(lods.GetIndices(level), lods.NumTriangles(level) * 3 * sizeof(int));
+			entry.numIndices += lods.NumTriangles(level) * 3;
+		}
+	}
+
+	std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+	if ( !out )
+		return false;
+
+	// the magic is written last, so a file cut short is never mistaken for a valid cache
+	out.write((const char*)&h, sizeof(h));
+	out.write((const char*)e.data(), e.size() * sizeof(MeshCacheEntry));
+	out.write(body.data(), body.size());
+
+	h.magic = MESH_CACHE_MAGIC;
+	out.seekp(0);
+	out.write((const char*)&h, sizeof(h));
+
+	return (bool)out;
+}
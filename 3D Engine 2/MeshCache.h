@@ -0,0 +1,129 @@
+#pragma once
+#include "MappedFile.h"
+#include "Shapes.h"
+#include "LOD.h"
+#include <string>
+
+class Scene;
+
+// "MESH" read as a little endian int
+#define MESH_CACHE_MAGIC 0x4853454D
+
+// bump whenever the layout below or the import processing changes
+#define MESH_CACHE_VERSION 1
+
+// appended to the source file's path to name its cache
+#define MESH_CACHE_EXTENSION ".mesh"
+
+#define MESH_CACHE_NORMALS 1
+#define MESH_CACHE_TEXCOORDS 2
+
+// Binary mesh files written the first time a model is imported.
+// On later runs the file is memory mapped and its arrays are used in place,
+// skipping Assimp, the mesh optimizer and the LOD builder entirely.
+//
+// layout, everything 4 byte aligned:
+//   MeshCacheHeader
+//   MeshCacheEntry for each mesh
+//   for each mesh, starting at its entry's offset:
+//     positions, 3 floats per vertex
+//     normals, 3 floats per vertex, if MESH_CACHE_NORMALS is set
+//     texture coordinates, 2 floats per vertex, if MESH_CACHE_TEXCOORDS is set
+//     MeshCacheLevel for each level of detail
+//     indices of every level, one after another
+
+struct MeshCacheHeader {
+
+	int magic;
+	int version;
+
+	// size and modification time of the source file the cache was built from
+	long long sourceSize;
+	long long sourceModified;
+
+	int numMeshes;
+	int reserved;
+
+};
+
+struct MeshCacheEntry {
+
+	int numVertices;
+	int flags;
+	int numLevels;
+	int numIndices;
+
+	float boundsMin[3];
+	float boundsMax[3];
+
+	// bounding sphere used by the LOD chain
+	float center[3];
+	float radius;
+
+	// from the start of the file
+	long long offset;
+
+};
+
+struct MeshCacheLevel {
+
+	int numTriangles;
+	float error;
+
+};
+
+// arrays of one mesh, pointing straight into the mapped file
+// only valid while the MeshCache that returned it stays open
+struct CachedMesh {
+
+	int numVertices;
+
+	const float* positions;
+	const float* normals;
+	const float* texCoords;
+
+	AABB bounds;
+
+	// bounding sphere of the levels of detail
+	Vec3 center;
+	float radius;
+
+	int numLevels;
+	const MeshCacheLevel* levels;
+	const int* indices;
+
+	// copies the levels of detail into a chain that outlives the cache
+	void GetLODs(LODChain& lods) const;
+
+};
+
+class MeshCache {
+
+private:
+
+	MappedFile file;
+
+	const MeshCacheHeader* header = nullptr;
+	const MeshCacheEntry* entries = nullptr;
+
+public:
+
+	MeshCache();
+
+	// maps the cache for a model, importing the model and writing
+	// the cache first if it is missing or older than the model
+	bool Load(const std::string& sourcePath, int numLODs = LOD_DEFAULT_LEVELS);
+
+	// maps an existing cache, fails if it is malformed or does not match the source file
+	bool Open(const std::string& cachePath, const std::string& sourcePath);
+	void Close();
+
+	int NumMeshes() const;
+	CachedMesh MeshAt(int meshIndex) const;
+
+	// writes every mesh of an imported scene
+	static bool Write(const std::string& cachePath, const std::string& sourcePath, const Scene& scene);
+
+	static std::string CachePath(const std::string& sourcePath);
+
+};
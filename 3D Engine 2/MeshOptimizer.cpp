@@ -0,0 +1,257 @@
+#include "MeshOptimizer.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <math.h>
+
+float MeshOptimizer::ACMR(const int* indices, int numTriangles, int numVertices, int cacheSize)
+{
+	if (numTriangles == 0)
+		return 0;
+
+	// a vertex is in the FIFO if it was pushed fewer than cacheSize pushes ago
+	std::vector<int> pushedAt(numVertices, -cacheSize - 1);
+	int pushes = 0;
+	int misses = 0;
+
+	for (int i = 0; i < numTriangles * 3; ++i) {
+
+		int v = indices[i];
+
+		if (pushes - pushedAt[v] > cacheSize) {
+			pushedAt[v] = pushes++;
+			++misses;
+		}
+	}
+
+	return (float)misses / numTriangles;
+}
+
+static int SkipDeadEnd(const std::vector<int>& liveTriangles, std::vector<int>& deadEnds, int& cursor, int numVertices)
+{
+	// recently used vertices that still have triangles left
+	while (!deadEnds.empty()) {
+
+		int d = deadEnds.back();
+		deadEnds.pop_back();
+
+		if (liveTriangles[d] > 0)
+			return d;
+	}
+
+	// otherwise the next vertex in input order that still has triangles left
+	while (cursor < numVertices) {
+
+		if (liveTriangles[cursor] > 0)
+			return cursor;
+
+		++cursor;
+	}
+
+	return -1;
+}
+
+void MeshOptimizer::OptimizeVertexCache(int* indices, int numTriangles, int numVertices, std::vector<int>* clusterStarts, int cacheSize)
+{
+	if (numTriangles == 0)
+		return;
+
+	// triangles around each vertex, stored contiguously
+	std::vector<int> offsets(numVertices + 1, 0);
+	for (int i = 0; i < numTriangles * 3; ++i)
+		++offsets[indices[i] + 1];
+
+	for (int v = 0; v < numVertices; ++v)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<int> adjacency(numTriangles * 3);
+	std::vector<int> filled(offsets.begin(), offsets.end() - 1);
+
+	for (int t = 0; t < numTriangles; ++t)
+		for (int i = 0; i < 3; ++i)
+			adjacency[filled[indices[t * 3 + i]]++] = t;
+
+	// triangles not yet emitted that use each vertex
+	std::vector<int> liveTriangles(numVertices);
+	for (int v = 0; v < numVertices; ++v)
+		liveTriangles[v] = offsets[v + 1] - offsets[v];
+
+	std::vector<int> cacheTime(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<int> deadEnds;
+	std::vector<int> candidates;
+
+	std::vector<int> output;
+	output.reserve(numTriangles * 3);
+
+	if (clusterStarts != nullptr)
+		clusterStarts->clear();
+
+	int timeStamp = cacheSize + 1;
+	int cursor = 0;
+
+	// the vertex whose triangles are being fanned out
+	int fanning = SkipDeadEnd(liveTriangles, deadEnds, cursor, numVertices);
+	bool newCluster = true;
+
+	while (fanning >= 0) {
+
+		if (newCluster && clusterStarts != nullptr)
+			clusterStarts->push_back((int)output.size() / 3);
+
+		candidates.clear();
+
+		// emit every remaining triangle around the fanning vertex
+		for (int a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+
+			int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int i = 0; i < 3; ++i) {
+
+				int v = indices[t * 3 + i];
+
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+
+				--liveTriangles[v];
+
+				// the vertex was not in the cache, so it is pushed in now
+				if (timeStamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timeStamp++;
+			}
+
+			emitted[t] = true;
+		}
+
+		// pick the candidate that will still be in the cache when its triangles are drawn
+		int next = -1;
+		int bestPriority = -1;
+
+		for (int v : candidates) {
+
+			if (liveTriangles[v] <= 0)
+				continue;
+
+			int priority = 0;
+
+			// each remaining triangle could push up to 2 more vertices
+			if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = timeStamp - cacheTime[v];
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		// nothing useful is left in the cache, this starts a new cluster
+		newCluster = next == -1;
+		if (newCluster)
+			next = SkipDeadEnd(liveTriangles, deadEnds, cursor, numVertices);
+
+		fanning = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(int* indices, int numTriangles, const float* positions, int stride, const std::vector<int>& clusterStarts)
+{
+	int numClusters = (int)clusterStarts.size();
+	if (numClusters <= 1)
+		return;
+
+	auto Position = [&](int v) {
+		const float* p = positions + v * stride;
+		return Vec3(p[0], p[1], p[2]);
+	};
+
+	// area weighted centroid of the whole mesh
+	Vec3 meshCentroid;
+	float meshArea = 0;
+
+	std::vector<Vec3> clusterCentroids(numClusters);
+	std::vector<Vec3> clusterNormals(numClusters);
+
+	for (int c = 0; c < numClusters; ++c) {
+
+		int start = clusterStarts[c];
+		int end = c + 1 < numClusters ? clusterStarts[c + 1] : numTriangles;
+
+		Vec3 centroid;
+		Vec3 normal;
+		float area = 0;
+
+		for (int t = start; t < end; ++t) {
+
+			Vec3 p1 = Position(indices[t * 3]);
+			Vec3 p2 = Position(indices[t * 3 + 1]);
+			Vec3 p3 = Position(indices[t * 3 + 2]);
+
+			// length of the cross product is twice the area
+			Vec3 cross = (p2 - p1) % (p3 - p1);
+			float triArea = cross.Length();
+
+			centroid += (p1 + p2 + p3) * (triArea / 3);
+			normal += cross;
+			area += triArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		clusterCentroids[c] = area > 0 ? centroid / area : Position(indices[start * 3]);
+		clusterNormals[c] = normal.Length() > 0 ? normal.Normalized() : normal;
+	}
+
+	if (meshArea > 0)
+		meshCentroid /= meshArea;
+
+	// clusters far out along their own normal are the likeliest occluders
+	std::vector<std::pair<float, int>> order(numClusters);
+	for (int c = 0; c < numClusters; ++c)
+		order[c] = { -((clusterCentroids[c] - meshCentroid) * clusterNormals[c]), c };
+
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<int> sorted;
+	sorted.reserve(numTriangles * 3);
+
+	for (const auto& entry : order) {
+
+		int c = entry.second;
+		int start = clusterStarts[c];
+		int end = c + 1 < numClusters ? clusterStarts[c + 1] : numTriangles;
+
+		sorted.insert(sorted.end(), indices + start * 3, indices + end * 3);
+	}
+
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(int* indices, int numTriangles, int numVertices, std::vector<int>& vertexOrder)
+{
+	std::vector<int> newIndex(numVertices, -1);
+
+	vertexOrder.clear();
+	vertexOrder.reserve(numVertices);
+
+	for (int i = 0; i < numTriangles * 3; ++i) {
+
+		int v = indices[i];
+
+		if (newIndex[v] == -1) {
+			newIndex[v] = (int)vertexOrder.size();
+			vertexOrder.push_back(v);
+		}
+
+		indices[i] = newIndex[v];
+	}
+
+	// keep any unreferenced vertices so the vertex count does not change
+	for (int v = 0; v < numVertices; ++v)
+		if (newIndex[v] == -1)
+			vertexOrder.push_back(v);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+// size of the simulated post transform vertex cache
+#define VERTEX_CACHE_SIZE 16
+
+// Import time reordering of index and vertex buffers.
+// Triangles are put in an order that reuses recently transformed vertices,
+// clusters of triangles are then sorted so outward facing ones draw first,
+// and finally vertices are renumbered in the order they are first used.
+namespace MeshOptimizer {
+
+	// average cache miss ratio, vertex shader runs per triangle with a FIFO cache
+	// 3.0 is the worst possible, around 0.5 to 0.7 is typical for an optimized mesh
+	float ACMR(const int* indices, int numTriangles, int numVertices, int cacheSize = VERTEX_CACHE_SIZE);
+
+	// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander, Nehab, Barczak
+	// reorders the triangles in place, clusterStarts receives the first triangle of every cluster,
+	// points where the cache would have to be flushed anyway, and can be passed to OptimizeOverdraw
+	void OptimizeVertexCache(int* indices, int numTriangles, int numVertices, std::vector<int>* clusterStarts = nullptr, int cacheSize = VERTEX_CACHE_SIZE);
+
+	// sorts the clusters found by OptimizeVertexCache so that clusters on the outside
+	// of the mesh, facing away from its center, are drawn before the ones they are likely to hide
+	// positions are floats with stride floats between each vertex
+	void OptimizeOverdraw(int* indices, int numTriangles, const float* positions, int stride, const std::vector<int>& clusterStarts);
+
+	// renumbers the vertices in the order they are first referenced by the indices, updating the indices
+	// vertexOrder receives the old index of each new vertex, unreferenced vertices go at the end
+	void OptimizeVertexFetch(int* indices, int numTriangles, int numVertices, std::vector<int>& vertexOrder);
+
+}
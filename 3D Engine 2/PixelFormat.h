@@ -0,0 +1,96 @@
+#pragma once
+#include "Vec4.h"
+#include <string.h>
+#include <immintrin.h>
+
+// Pixel formats for TypedSurface.
+// Each format names the type one pixel is stored as and how it converts to
+// and from a Vec4, so a surface only pays for the conversion its format needs.
+
+// 8 bits per channel packed in an int, red in the low byte and alpha in the high byte
+struct RGBA8 {
+
+	typedef int Storage;
+	static constexpr int CHANNELS = 4;
+
+	// where each channel sits in the int, for SDL and texture files
+	static constexpr unsigned int R_MASK = 0x000000ff;
+	static constexpr unsigned int G_MASK = 0x0000ff00;
+	static constexpr unsigned int B_MASK = 0x00ff0000;
+	static constexpr unsigned int A_MASK = 0xff000000;
+
+	static inline Storage Encode(const Vec4& v) {
+		return (int)((unsigned int)(v.r * 255) | (unsigned int)(v.g * 255) << 8 | (unsigned int)(v.b * 255) << 16 | (unsigned int)(v.a * 255) << 24);
+	}
+
+	static inline Vec4 Decode(Storage color) {
+		return Vec4((color & 0xff) / 255.0f, ((color >> 8) & 0xff) / 255.0f, ((color >> 16) & 0xff) / 255.0f, ((unsigned int)color >> 24) / 255.0f);
+	}
+
+};
+
+// a single 32 bit float, depth buffers and shadow maps
+struct R32F {
+
+	typedef float Storage;
+	static constexpr int CHANNELS = 1;
+
+	static inline Storage Encode(const Vec4& v) {
+		return v.r;
+	}
+
+	static inline Vec4 Decode(Storage value) {
+		return Vec4(value, 0, 0, 1);
+	}
+
+};
+
+// two 16 bit half floats, for things like screen space velocities or packed normals
+struct RG16F {
+
+	struct Storage {
+		unsigned short r;
+		unsigned short g;
+	};
+
+	static constexpr int CHANNELS = 2;
+
+	// F16C converts both halves in one instruction
+	static inline Storage Encode(const Vec4& v) {
+
+		int bits = _mm_cvtsi128_si32(_mm_cvtps_ph(_mm_setr_ps(v.r, v.g, 0, 0), _MM_FROUND_TO_NEAREST_INT));
+
+		Storage halves;
+		memcpy(&halves, &bits, sizeof(Storage));
+
+		return halves;
+	}
+
+	static inline Vec4 Decode(Storage halves) {
+
+		int bits;
+		memcpy(&bits, &halves, sizeof(Storage));
+
+		float rg[4];
+		_mm_storeu_ps(rg, _mm_cvtph_ps(_mm_cvtsi32_si128(bits)));
+
+		return Vec4(rg[0], rg[1], 0, 1);
+	}
+
+};
+
+// four 32 bit floats, HDR render targets that are tonemapped later
+struct RGBA32F {
+
+	typedef Vec4 Storage;
+	static constexpr int CHANNELS = 4;
+
+	static inline Storage Encode(const Vec4& v) {
+		return v;
+	}
+
+	static inline Vec4 Decode(const Storage& v) {
+		return v;
+	}
+
+};
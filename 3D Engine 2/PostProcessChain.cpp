@@ -0,0 +1,224 @@
+#include "PostProcessChain.h"
+#include "Utility.h"
+#include <string.h>
+#include <algorithm>
+#include <immintrin.h>
+
+// a stage's coefficients laid out for the kernel, the matrix is row major
+struct KernelStage {
+
+	bool tonemap;
+	float matrix[16];
+	float offset[4];
+	float exposure;
+	float invWhiteSquared;
+
+};
+
+static void RunStages(int* pixels, int count, const KernelStage* stages, int numStages) {
+
+	const __m256i byteMask = _mm256_set1_epi32(0xff);
+	const __m256 toUnit = _mm256_set1_ps(1 / 255.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 toByte = _mm256_set1_ps(255);
+
+	for (int i = 0; i < count; i += 8) {
+
+		int* p = pixels + i;
+		int n = std::min(8, count - i);
+
+		// the last few pixels go through a full register's worth of space
+		int tail[8] = {};
+		if (n < 8) {
+			memcpy(tail, p, n * sizeof(int));
+			p = tail;
+		}
+
+		// one register per channel, 8 pixels across
+		__m256i packed = _mm256_loadu_si256((const __m256i*)p);
+		__m256 c[4];
+
+		c[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(packed, byteMask)), toUnit);
+		c[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packed, 8), byteMask)), toUnit);
+		c[2] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packed, 16), byteMask)), toUnit);
+		c[3] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(packed, 24)), toUnit);
+
+		for (const KernelStage* s = stages; s < stages + numStages; ++s) {
+
+			if (s->tonemap) {
+
+				__m256 exposure = _mm256_set1_ps(s->exposure);
+				__m256 invWhiteSquared = _mm256_set1_ps(s->invWhiteSquared);
+
+				// x * (1 + x / white^2) / (1 + x)
+				for (int ch = 0; ch < 3; ++ch) {
+
+					__m256 x = _mm256_mul_ps(c[ch], exposure);
+					__m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(one, _mm256_mul_ps(x, invWhiteSquared)));
+
+					c[ch] = _mm256_div_ps(numerator, _mm256_add_ps(one, x));
+				}
+
+				continue;
+			}
+
+			__m256 result[4];
+
+			for (int row = 0; row < 4; ++row) {
+
+				const float* m = s->matrix + row * 4;
+
+				__m256 sum = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), c[0]), _mm256_mul_ps(_mm256_set1_ps(m[1]), c[1]));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(m[2]), c[2]));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(m[3]), c[3]));
+
+				result[row] = _mm256_add_ps(sum, _mm256_set1_ps(s->offset[row]));
+			}
+
+			for (int ch = 0; ch < 4; ++ch)
+				c[ch] = result[ch];
+		}
+
+		// clamp, round and pack the channels back together
+		__m256i channels[4];
+		for (int ch = 0; ch < 4; ++ch)
+			channels[ch] = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(c[ch], zero), one), toByte));
+
+		packed = _mm256_or_si256(
+			_mm256_or_si256(channels[0], _mm256_slli_epi32(channels[1], 8)),
+			_mm256_or_si256(_mm256_slli_epi32(channels[2], 16), _mm256_slli_epi32(channels[3], 24))
+		);
+
+		_mm256_storeu_si256((__m256i*)p, packed);
+
+		if (n < 8)
+			memcpy(pixels + i, tail, n * sizeof(int));
+	}
+
+}
+
+PostProcessChain::PostProcessChain() {}
+
+PostProcessChain& PostProcessChain::AddAffine(const Mat4& matrix, const Vec4& offset) {
+
+	// matrix * (last * c + lastOffset) + offset
+	if (!stages.empty() && stages.back().type == STAGE_AFFINE) {
+
+		Stage& last = stages.back();
+
+		last.offset = matrix * last.offset + offset;
+		last.matrix = matrix * last.matrix;
+
+		return *this;
+	}
+
+	Stage stage;
+	stage.type = STAGE_AFFINE;
+	stage.matrix = matrix;
+	stage.offset = offset;
+	stage.exposure = 1;
+	stage.whitePoint = 1;
+
+	stages.push_back(stage);
+
+	return *this;
+}
+
+PostProcessChain& PostProcessChain::Tint(const Vec4& target, float alpha) {
+
+	if (alpha < 0)
+		alpha = 0;
+	if (alpha > 1)
+		alpha = 1;
+
+	return AddAffine(Mat4::Identity * (1 - alpha), target * alpha);
+}
+
+PostProcessChain& PostProcessChain::Invert() {
+
+	return AddAffine(Mat4::GetScale(-1, -1, -1), { 1, 1, 1, 0 });
+}
+
+PostProcessChain& PostProcessChain::Contrast(float contrast) {
+
+	float scale = 1 + contrast;
+	float shift = 0.5f * (1 - scale);
+
+	return AddAffine(Mat4::GetScale(scale, scale, scale), { shift, shift, shift, 0 });
+}
+
+PostProcessChain& PostProcessChain::Saturation(float saturation) {
+
+	// Rec. 709 luminance
+	const Vec4 luminance = { 0.2126f, 0.7152f, 0.0722f, 0 };
+
+	Mat4 matrix;
+
+	for (int r = 0; r < 3; ++r)
+		for (int c = 0; c < 3; ++c)
+			matrix(r, c) = (1 - saturation) * (&luminance.x)[c] + (r == c ? saturation : 0);
+
+	return AddAffine(matrix, { 0, 0, 0, 0 });
+}
+
+PostProcessChain& PostProcessChain::ColorMatrix(const Mat4& matrix, const Vec4& offset) {
+
+	return AddAffine(matrix, offset);
+}
+
+PostProcessChain& PostProcessChain::ToneMap(float exposure, float whitePoint) {
+
+	Stage stage;
+	stage.type = STAGE_TONEMAP;
+	stage.exposure = exposure;
+	stage.whitePoint = whitePoint;
+
+	stages.push_back(stage);
+
+	return *this;
+}
+
+void PostProcessChain::Clear() {
+	stages.clear();
+}
+
+bool PostProcessChain::IsEmpty() const {
+	return stages.empty();
+}
+
+void PostProcessChain::Apply(Surface& surface) const {
+
+	if (stages.empty())
+		return;
+
+	surface.Compress(SURFACE_UNCOMPRESSED);
+
+	std::vector<KernelStage> kernelStages(stages.size());
+
+	for (int i = 0; i < (int)stages.size(); ++i) {
+
+		const Stage& stage = stages[i];
+		KernelStage& k = kernelStages[i];
+
+		k.tonemap = stage.type == STAGE_TONEMAP;
+
+		for (int r = 0; r < 4; ++r) {
+			for (int c = 0; c < 4; ++c)
+				k.matrix[r * 4 + c] = stage.matrix(r, c);
+
+			k.offset[r] = (&stage.offset.x)[r];
+		}
+
+		k.exposure = stage.exposure;
+		k.invWhiteSquared = 1 / (stage.whitePoint * stage.whitePoint);
+	}
+
+	// pixels are independent of each other, so any layout can be walked straight through
+	int count = surface.width * surface.height;
+
+	ParallelBands(count, count >= PARALLEL_PIXELS, [&](int first, int last) {
+		RunStages(surface.pPixels + first, last - first, kernelStages.data(), (int)kernelStages.size());
+	});
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "Surface.h"
+#include "Mat4.h"
+#include <vector>
+
+// A list of per pixel color operations run over a surface in a single pass.
+// Neighboring operations that are affine in the color, like tint, invert,
+// contrast, saturation and color matrices, are multiplied into one matrix
+// as they are added, so a whole chain of them costs one matrix per pixel.
+// The pass runs 8 pixels at a time in AVX registers, split across threads.
+// Colors are only clamped when they are written back, unlike calling the
+// Surface operations one after another, which clamp after each of them.
+class PostProcessChain
+{
+private:
+
+	enum {
+		STAGE_AFFINE,
+		STAGE_TONEMAP
+	};
+
+	struct Stage {
+
+		int type;
+
+		// color = matrix * color + offset
+		Mat4 matrix;
+		Vec4 offset;
+
+		float exposure;
+		float whitePoint;
+
+	};
+
+	std::vector<Stage> stages;
+
+	PostProcessChain& AddAffine(const Mat4& matrix, const Vec4& offset);
+
+public:
+
+	PostProcessChain();
+
+	// same as Surface::Tint, moves every channel alpha of the way to target
+	PostProcessChain& Tint(const Vec4& target, float alpha);
+
+	// same as Surface::Invert, alpha is left alone
+	PostProcessChain& Invert();
+
+	// same as Surface::SetContrast, scales the color channels away from gray
+	PostProcessChain& Contrast(float contrast);
+
+	// 0 is grayscale, 1 leaves the colors alone
+	PostProcessChain& Saturation(float saturation);
+
+	// any affine color transform, the color is a column vector r, g, b, a
+	PostProcessChain& ColorMatrix(const Mat4& matrix, const Vec4& offset = { 0, 0, 0, 0 });
+
+	// extended Reinhard, colors are scaled by exposure and whitePoint maps to 1
+	PostProcessChain& ToneMap(float exposure, float whitePoint);
+
+	void Clear();
+	bool IsEmpty() const;
+
+	// runs the chain over the surface, its mip maps are left alone
+	void Apply(Surface& surface) const;
+
+};
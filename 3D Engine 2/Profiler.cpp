@@ -0,0 +1,206 @@
+#include "Profiler.h"
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+
+thread_local unsigned long long profileCounters[PROFILE_NUM_COUNTERS] = {};
+
+struct ProfileEvent {
+
+	const char* name;
+	long long start;
+	long long duration;
+
+	bool hasCounters;
+	float counterShares[PROFILE_NUM_COUNTERS];
+
+};
+
+// a ring of events only one thread writes to at a time
+struct ThreadBuffer {
+
+	int id;
+	std::string name;
+
+	std::vector<ProfileEvent> events;
+
+	// total events ever written, the newest is at (count - 1) % size
+	std::atomic<long long> count;
+
+	ThreadBuffer(int id) : id(id), events(PROFILER_EVENTS_PER_THREAD), count(0) {}
+
+};
+
+static std::mutex buffersMutex;
+static std::vector<ThreadBuffer*> allBuffers;
+
+// the renderer starts new threads for every draw, so buffers are handed
+// on from threads that have ended instead of one being made for each
+static std::vector<ThreadBuffer*> freeBuffers;
+
+struct BufferOwner {
+
+	ThreadBuffer* buffer = nullptr;
+
+	ThreadBuffer* Get() {
+
+		if (buffer != nullptr)
+			return buffer;
+
+		std::lock_guard<std::mutex> lock(buffersMutex);
+
+		if (!freeBuffers.empty()) {
+			buffer = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+		else {
+			buffer = new ThreadBuffer((int)allBuffers.size());
+			allBuffers.push_back(buffer);
+		}
+
+		return buffer;
+	}
+
+	~BufferOwner() {
+
+		if (buffer == nullptr)
+			return;
+
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		freeBuffers.push_back(buffer);
+	}
+
+};
+
+static thread_local BufferOwner bufferOwner;
+
+void Profiler::SetThreadName(const char* name) {
+
+	ThreadBuffer* buffer = bufferOwner.Get();
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	buffer->name = name;
+}
+
+void Profiler::Record(const char* name, long long start, long long end, const float* counterShares) {
+
+	ThreadBuffer* buffer = bufferOwner.Get();
+
+	long long index = buffer->count.load(std::memory_order_relaxed);
+	ProfileEvent& e = buffer->events[index % PROFILER_EVENTS_PER_THREAD];
+
+	e.name = name;
+	e.start = start;
+	e.duration = end - start;
+	e.hasCounters = counterShares != nullptr;
+
+	if (e.hasCounters)
+		for (int i = 0; i < PROFILE_NUM_COUNTERS; ++i)
+			e.counterShares[i] = counterShares[i];
+
+	buffer->count.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::SaveTrace(const std::string& filename) {
+
+	std::ofstream file(filename);
+
+	if (!file.is_open())
+		return false;
+
+	static const char* STAGE_NAMES[] = { "clipping", "rasterization", "pixel shading" };
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[\n";
+
+	bool first = true;
+
+	for (ThreadBuffer* buffer : allBuffers) {
+
+		std::string name = buffer->name.empty() ? "Thread " + std::to_string(buffer->id) : buffer->name;
+
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+			<< ",\"args\":{\"name\":\"" << name << "\"}}";
+		first = false;
+
+		long long count = buffer->count.load(std::memory_order_acquire);
+		long long oldest = count > PROFILER_EVENTS_PER_THREAD ? count - PROFILER_EVENTS_PER_THREAD : 0;
+
+		for (long long i = oldest; i < count; ++i) {
+
+			const ProfileEvent& e = buffer->events[i % PROFILER_EVENTS_PER_THREAD];
+
+			// times are in microseconds
+			file << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+				<< ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << e.duration / 1000.0;
+
+			if (e.hasCounters) {
+
+				// clipping is whatever was not spent drawing the clipped triangles
+				float shares[] = {
+					1 - e.counterShares[PROFILE_RASTERIZATION],
+					e.counterShares[PROFILE_RASTERIZATION] - e.counterShares[PROFILE_PIXEL_SHADING],
+					e.counterShares[PROFILE_PIXEL_SHADING]
+				};
+
+				file << ",\"args\":{";
+
+				for (int c = 0; c < 3; ++c)
+					file << (c ? "," : "") << "\"" << STAGE_NAMES[c] << " %\":" << shares[c] * 100;
+
+				file << "}";
+			}
+
+			file << "}";
+		}
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return true;
+}
+
+void Profiler::Clear() {
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	for (ThreadBuffer* buffer : allBuffers)
+		buffer->count.store(0, std::memory_order_release);
+}
+
+ProfileScope::ProfileScope(const char* name, bool withCounters)
+	:
+	name(name), withCounters(withCounters)
+{
+	if (withCounters) {
+
+		for (int i = 0; i < PROFILE_NUM_COUNTERS; ++i)
+			startCounters[i] = profileCounters[i];
+
+		startTicks = __rdtsc();
+	}
+
+	start = Profiler::Now();
+}
+
+ProfileScope::~ProfileScope() {
+
+	long long end = Profiler::Now();
+
+	if (!withCounters) {
+		Profiler::Record(name, start, end, nullptr);
+		return;
+	}
+
+	float ticks = (float)(__rdtsc() - startTicks);
+	float shares[PROFILE_NUM_COUNTERS];
+
+	for (int i = 0; i < PROFILE_NUM_COUNTERS; ++i)
+		shares[i] = ticks > 0 ? (profileCounters[i] - startCounters[i]) / ticks : 0;
+
+	Profiler::Record(name, start, end, shares);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <immintrin.h>
+
+// times the stages of each frame, the trace opens in chrome://tracing or Perfetto
+// every PROFILE_ macro compiles to nothing unless this is defined
+//#define PROFILING
+
+// events each thread keeps, its oldest are overwritten past this
+#define PROFILER_EVENTS_PER_THREAD 16384
+
+// where an instance saves its trace when it ends
+#define PROFILER_TRACE_FILE "trace.json"
+
+// work too short and frequent to get its own event, like shading one pixel,
+// is added up per thread and reported as shares of the PROFILE_STAGES event around it
+enum ProfileCounters {
+
+	PROFILE_RASTERIZATION,
+	PROFILE_PIXEL_SHADING,
+
+	PROFILE_NUM_COUNTERS
+
+};
+
+// time stamp counter ticks each thread has spent in each counter
+extern thread_local unsigned long long profileCounters[PROFILE_NUM_COUNTERS];
+
+namespace Profiler {
+
+	// names the row this thread's events appear on
+	void SetThreadName(const char* name);
+
+	// writes the Chrome trace event format, returns false if the file could not be opened
+	// threads can keep recording, but events being written while saving may be cut off
+	bool SaveTrace(const std::string& filename);
+
+	// forgets every event, only while nothing is being profiled
+	void Clear();
+
+	// nanoseconds since the program started
+	inline long long Now() {
+		static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	// counterShares is null for events without counter shares
+	void Record(const char* name, long long start, long long end, const float* counterShares);
+
+}
+
+// records an event from construction until it goes out of scope
+class ProfileScope {
+
+private:
+
+	const char* name;
+	long long start;
+
+	// counters are only read by PROFILE_STAGES scopes
+	bool withCounters;
+	unsigned long long startTicks;
+	unsigned long long startCounters[PROFILE_NUM_COUNTERS];
+
+public:
+
+	ProfileScope(const char* name, bool withCounters = false);
+	~ProfileScope();
+
+};
+
+// adds the ticks from construction until it goes out of scope to a counter
+class ProfileTimer {
+
+private:
+
+	int counter;
+	unsigned long long start;
+
+public:
+
+	inline ProfileTimer(int counter) : counter(counter), start(__rdtsc()) {}
+
+	inline ~ProfileTimer() {
+		profileCounters[counter] += __rdtsc() - start;
+	}
+
+};
+
+#define PROFILE_CONCAT_(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_(A, B)
+
+#ifdef PROFILING
+#define PROFILE_SCOPE(NAME) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(NAME)
+#define PROFILE_STAGES(NAME) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(NAME, true)
+#define PROFILE_TIME(COUNTER) ProfileTimer PROFILE_CONCAT(profileTimer, __LINE__)(COUNTER)
+#define PROFILE_THREAD_NAME(NAME) Profiler::SetThreadName(NAME)
+#define PROFILE_SAVE(FILENAME) Profiler::SaveTrace(FILENAME)
+#else
+#define PROFILE_SCOPE(NAME)
+#define PROFILE_STAGES(NAME)
+#define PROFILE_TIME(COUNTER)
+#define PROFILE_THREAD_NAME(NAME)
+#define PROFILE_SAVE(FILENAME)
+#endif
@@ -0,0 +1,91 @@
+#include "Quantization.h"
+#include <assert.h>
+
+#define QUANTIZED_MAX 65535.0f
+
+PositionQuantizer::PositionQuantizer() : offset(0, 0, 0), scale(1, 1, 1) {}
+
+PositionQuantizer::PositionQuantizer(const AABB& bounds) : offset(bounds.min) {
+
+	Vec3 size = bounds.max - bounds.min;
+
+	// flat boxes still need a non zero scale
+	scale = {
+		size.x > 0 ? size.x / QUANTIZED_MAX : 1,
+		size.y > 0 ? size.y / QUANTIZED_MAX : 1,
+		size.z > 0 ? size.z / QUANTIZED_MAX : 1
+	};
+
+}
+
+static unsigned short QuantizeComponent(float value, float offset, float scale) {
+
+	float q = (value - offset) / scale + 0.5f;
+
+	if (q < 0)
+		q = 0;
+	if (q > QUANTIZED_MAX)
+		q = QUANTIZED_MAX;
+
+	return (unsigned short)q;
+
+}
+
+QuantizedPosition PositionQuantizer::Encode(const Vec3& position) const {
+
+	return {
+		QuantizeComponent(position.x, offset.x, scale.x),
+		QuantizeComponent(position.y, offset.y, scale.y),
+		QuantizeComponent(position.z, offset.z, scale.z),
+		0
+	};
+
+}
+
+static short ToSnorm(float v) {
+
+	if (v < -1)
+		v = -1;
+	if (v > 1)
+		v = 1;
+
+	return (short)roundf(v * 32767.0f);
+
+}
+
+OctNormal EncodeNormal(const Vec3& normal) {
+
+	// project onto the octahedron |x| + |y| + |z| = 1
+	float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+
+	if (sum == 0)
+		return { 0, 0 };
+
+	float x = normal.x / sum;
+	float y = normal.y / sum;
+
+	// fold the lower hemisphere over the diagonals
+	if (normal.z < 0) {
+
+		float foldedX = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+		float foldedY = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return { ToSnorm(x), ToSnorm(y) };
+
+}
+
+void NarrowIndices(const int* indices, int numIndices, std::vector<unsigned short>& output) {
+
+	output.resize(numIndices);
+
+	for (int i = 0; i < numIndices; ++i) {
+
+		assert(indices[i] >= 0 && indices[i] < MAX_SHORT_INDEXED_VERTICES);
+		output[i] = (unsigned short)indices[i];
+	}
+
+}
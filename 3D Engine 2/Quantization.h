@@ -0,0 +1,82 @@
+#pragma once
+#include "Vec3.h"
+#include "Vec4.h"
+#include "Shapes.h"
+#include <vector>
+#include <math.h>
+
+// Compact vertex attribute formats.
+// Encoding happens once at import, decoding is cheap enough to do
+// on every vertex fetch inside a vertex shader.
+
+// position stored as 16 bit fractions of the mesh's bounding box
+// w is padding so the struct stays 8 byte aligned
+struct QuantizedPosition {
+
+	unsigned short x;
+	unsigned short y;
+	unsigned short z;
+	unsigned short w;
+
+};
+
+// unit vector folded onto an octahedron and stored as two 16 bit snorms
+// "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+struct OctNormal {
+
+	short x;
+	short y;
+
+};
+
+class PositionQuantizer {
+
+private:
+
+	// position = offset + quantized * scale
+	Vec3 offset;
+	Vec3 scale;
+
+public:
+
+	PositionQuantizer();
+	PositionQuantizer(const AABB& bounds);
+
+	QuantizedPosition Encode(const Vec3& position) const;
+
+	inline Vec4 Decode(const QuantizedPosition& q) const {
+
+		return {
+			offset.x + q.x * scale.x,
+			offset.y + q.y * scale.y,
+			offset.z + q.z * scale.z,
+			1
+		};
+	}
+
+};
+
+OctNormal EncodeNormal(const Vec3& normal);
+
+inline Vec3 DecodeNormal(const OctNormal& n) {
+
+	float x = n.x / 32767.0f;
+	float y = n.y / 32767.0f;
+	float z = 1 - fabsf(x) - fabsf(y);
+
+	// unfold the lower hemisphere
+	float t = fmaxf(-z, 0);
+	x += x >= 0 ? -t : t;
+	y += y >= 0 ? -t : t;
+
+	return Vec3(x, y, z).Normalized();
+}
+
+// 16 bit indices can address this many vertices
+#define MAX_SHORT_INDEXED_VERTICES 65536
+
+inline bool FitsShortIndices(int numVertices) {
+	return numVertices <= MAX_SHORT_INDEXED_VERTICES;
+}
+
+void NarrowIndices(const int* indices, int numIndices, std::vector<unsigned short>& output);
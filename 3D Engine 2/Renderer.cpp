@@ -26,9 +26,14 @@ void Renderer::SetRenderTarget(Surface& renderTarget) {
 	}
 }
 
+thread_local Renderer::PipelineStatistics* Renderer::pStatisticsShard = nullptr;
+
 bool Renderer::TestAndSetPixel(int x, int y, float normalizedDepth) {
 
+	COUNT_STATISTIC(depthTests, 1);
+
 	if (normalizedDepth < depthBuffer.GetPixel(x, y)) {
+		COUNT_STATISTIC(depthPasses, 1);
 		depthBuffer.PutPixel(x, y, normalizedDepth);
 		return true;
 	}
@@ -78,65 +83,87 @@ Surface& Renderer::GetRenderTarget() {
 	return *pRenderTarget;
 }
 
-Renderer::DepthBuffer::DepthBuffer(int width, int height) 
-	: 
-	width(width), height(height) 
-{
+void Renderer::BeginRecording(CommandList& list) {
+	pRecording = &list;
+}
 
-	pDepths = new float[width * height];
-	allocatedSpace = width * height;
+void Renderer::EndRecording() {
+	pRecording = nullptr;
+	pRecordingTarget = nullptr;
+}
 
+bool Renderer::IsRecording() const {
+	return pRecording != nullptr;
 }
 
-Renderer::DepthBuffer::DepthBuffer() 
-	: 
-	width(0), height(0), pDepths(nullptr), allocatedSpace(0) 
-{
+void Renderer::SetRecordingTarget(Renderer* target) {
+	pRecordingTarget = target;
 }
 
-Renderer::DepthBuffer::DepthBuffer(const DepthBuffer& db) 
-	: 
-	width(db.width), height(db.height), allocatedSpace(db.allocatedSpace)
-{
+void Renderer::RunInOrder(const std::function<void(Renderer&)>& command) {
 
-	pDepths = new float[width * height];
-	memcpy(pDepths, db.pDepths, width * height * sizeof(float));
+	if (pRecording != nullptr)
+		pRecording->commands.push_back(command);
+	else
+		command(*this);
 
 }
 
-Renderer::DepthBuffer& Renderer::DepthBuffer::operator=(const DepthBuffer& db) {
-
+void Renderer::Execute(const CommandList& list) {
 
-	Resize(db.width, db.height);
+	for (const std::function<void(Renderer&)>& command : list.commands)
+		command(*this);
 
-	memcpy(pDepths, db.pDepths, width * height * sizeof(float));
+}
 
-	return *this;
+const Renderer::PipelineStatistics& Renderer::GetDrawStatistics() const {
+	return drawStatistics;
+}
 
+const Renderer::PipelineStatistics& Renderer::GetStatistics() const {
+	return statistics;
 }
 
-Renderer::DepthBuffer::~DepthBuffer() {
-	delete[] pDepths;
+void Renderer::ResetStatistics() {
+	statistics = PipelineStatistics();
 }
 
-void Renderer::DepthBuffer::Resize(int width, int height) {
+Renderer::PipelineStatistics& Renderer::PipelineStatistics::operator+=(const PipelineStatistics& s) {
 
-	if ( width <= 0 || height <= 0 )
-		return;
+	vertexShaderInvocations += s.vertexShaderInvocations;
+	trianglesSubmitted += s.trianglesSubmitted;
+	trianglesOutside += s.trianglesOutside;
+	trianglesClipped += s.trianglesClipped;
+	clipperTriangles += s.clipperTriangles;
+	trianglesCulled += s.trianglesCulled;
+	trianglesRasterized += s.trianglesRasterized;
+	depthTests += s.depthTests;
+	depthPasses += s.depthPasses;
+	pixelShaderInvocations += s.pixelShaderInvocations;
 
-	if (width * height > allocatedSpace) {
+	return *this;
+}
 
-		delete[] pDepths;
-		pDepths = new float[width * height];
-		allocatedSpace = width * height;
+void Renderer::CommandList::Record(const std::function<void(Renderer&)>& command) {
+	commands.push_back(command);
+}
 
-	}
+void Renderer::CommandList::Clear() {
+	commands.clear();
+}
 
-	this->width = width;
-	this->height = height;
+bool Renderer::CommandList::IsEmpty() const {
+	return commands.empty();
+}
 
+int Renderer::CommandList::Size() const {
+	return (int)commands.size();
 }
 
+Renderer::DepthBuffer::DepthBuffer(int width, int height) : TypedSurface<R32F>(width, height) {}
+
+Renderer::DepthBuffer::DepthBuffer() {}
+
 void Renderer::DepthBuffer::SaveToFile(const std::string& filename) const {
 
 	unsigned int* normalized = new unsigned int[width * height];
@@ -145,7 +172,7 @@ void Renderer::DepthBuffer::SaveToFile(const std::string& filename) const {
 
 	for (int i = 0; i < width * height; ++i) {
 
-		normalized[i] = (unsigned int)std::fminf(255.0f, pDepths[i] * 255);
+		normalized[i] = (unsigned int)std::fminf(255.0f, pPixels[i] * 255);
 		normalized[i] |= (normalized[i] << 16) | (normalized[i] << 8) | aMask;
 	}
 
@@ -157,17 +184,12 @@ void Renderer::DepthBuffer::SaveToFile(const std::string& filename) const {
 
 }
 
-int Renderer::DepthBuffer::GetWidth() const {
-	return width;
-}
-
-int Renderer::DepthBuffer::GetHeight() const {
-	return height;
-}
-
 void Renderer::DepthBuffer::WhiteOut() {
 
 	// random float I found that is a super big number 0x7a7a7a7a
-	memset(pDepths, 0x7a, width * height * sizeof(float));
+	float farthest;
+	memset(&farthest, 0x7a, sizeof(float));
+
+	Fill(farthest);
 
 }
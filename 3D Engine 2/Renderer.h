@@ -5,12 +5,20 @@
 #include "Vec4.h"
 #include "Mat4.h"
 #include "Utility.h"
+#include "Profiler.h"
 #include <unordered_map>
 #include <thread>
+#include <type_traits>
+#include <functional>
+#include <memory>
+#include <immintrin.h>
 
 #define MAX_SUPPORTED_THREADS 32
 #define NUM_THREADS (std::thread::hardware_concurrency() - 2)
 
+// recorded draws with at least this many vertices are vertex shaded across threads
+#define PARALLEL_VERTICES 4096
+
 #define RF_BACKFACE_CULL 0x2
 #define RF_OUTLINES 0x4
 #define RF_WIREFRAME 0x8
@@ -18,8 +26,22 @@
 #define RF_MIPMAP 0x20
 #define RF_TRILINEAR 0x40
 
+// filter packed texels with 8 bit fixed point weights in SSE registers,
+// converting to floats once at the end instead of once per texel
+#define FIXED_POINT_SAMPLING
+
 #define RENDERER_DEBUG
 
+// counts what each draw did, see Renderer::PipelineStatistics
+// without it the counting compiles out
+#define PIPELINE_STATISTICS
+
+#ifdef PIPELINE_STATISTICS
+#define COUNT_STATISTIC(FIELD, AMOUNT) (pStatisticsShard->FIELD += (AMOUNT))
+#else
+#define COUNT_STATISTIC(FIELD, AMOUNT)
+#endif
+
 #ifdef RENDERER_DEBUG
 #undef NDEBUG
 #endif
@@ -50,41 +72,54 @@ public:
 
 	};
 
-	class DepthBuffer {
+	// what the pipeline did, like OpenGL's pipeline statistics queries
+	// each drawing thread counts into its own cache line, they are added up after the draw
+	struct alignas(64) PipelineStatistics {
+
+		long long vertexShaderInvocations = 0;
+		long long trianglesSubmitted = 0;
+
+		// triangles entirely outside one of the clip planes
+		long long trianglesOutside = 0;
+
+		// triangles cut by a clip plane, and how many triangles the cuts made
+		long long trianglesClipped = 0;
+		long long clipperTriangles = 0;
+
+		long long trianglesCulled = 0;
+		long long trianglesRasterized = 0;
+
+		long long depthTests = 0;
+		long long depthPasses = 0;
+
+		long long pixelShaderInvocations = 0;
+
+		PipelineStatistics& operator+=(const PipelineStatistics& statistics);
+
+	};
+
+	class DepthBuffer : public TypedSurface<R32F> {
 
 		friend class Renderer;
 
 	private:
-		float* pDepths;
-		int width;
-		int height;
-
-		int allocatedSpace;
 
 		DepthBuffer(int width, int height);
 
 		inline void PutPixel(int x, int y, float depth) {
-			pDepths[width * y + x] = depth;
+			PutValue(x, y, depth);
 		}
 
 	public:
 
 		DepthBuffer();
-		DepthBuffer(const DepthBuffer& db);
-		DepthBuffer& operator=(const DepthBuffer& db);
-		~DepthBuffer();
 
-		void Resize(int width, int height);
 		void SaveToFile(const std::string& filename) const;
 
-		int GetWidth() const;
-		int GetHeight() const;
-
 		void WhiteOut();
 
 		inline float GetPixel(int x, int y) const {
-
-			return pDepths[y * width + x];
+			return GetValue(x, y);
 		}
 
 	};
@@ -188,6 +223,11 @@ public:
 			return texture.GetPixel((int)(s * (texture.GetWidth() - 1)), (int)(t * (texture.GetHeight() - 1)));
 		}
 
+		// keeps a texel coordinate inside a texture of the given size
+		static inline int Clamp(int coordinate, int size) {
+			return coordinate < 0 ? 0 : coordinate >= size ? size - 1 : coordinate;
+		}
+
 		Vec4 BiLinearSample(const Surface& texture, const Vec2& texel) const {
 
 			// Equations for a Bi Linear Sample
@@ -198,21 +238,27 @@ public:
 			float t = texel.t - (int)(texel.t - WRAP_OFFSET);
 
 			// texel location minus half a pixel in x and y
-			int i = (texture.GetWidth() * s - 0.5);
-			int j = (texture.GetHeight() * t - 0.5);
+			float u = texture.GetWidth() * s - 0.5f;
+			float v = texture.GetHeight() * t - 0.5f;
+
+			int i = (int)floorf(u);
+			int j = (int)floorf(v);
 
 			// fractional parts of the displaced texel location
-			float alpha = i - (int)i;
-			float beta = j - (int)j;
+			float alpha = u - i;
+			float beta = v - j;
 
-			i = (int)i;
-			j = (int)j;
+			// the square is clamped to the edges of the texture
+			int i0 = Clamp(i, texture.GetWidth());
+			int j0 = Clamp(j, texture.GetHeight());
+			int i1 = Clamp(i + 1, texture.GetWidth());
+			int j1 = Clamp(j + 1, texture.GetHeight());
 
 			// texture samples of the 4 pixel square
-			const Vec4& c1 = texture.GetPixel(i, j);
-			const Vec4& c2 = i + 1 >= texture.GetWidth() ? texture.GetPixel(i, j) : texture.GetPixel(i + 1, j);
-			const Vec4& c3 = j + 1 >= texture.GetHeight() ? texture.GetPixel(i, j) : texture.GetPixel(i, j + 1);
-			const Vec4& c4 = i + 1 >= texture.GetWidth() || j + 1 >= texture.GetHeight() ? texture.GetPixel(i, j) : texture.GetPixel(i + 1, j + 1);
+			const Vec4& c1 = texture.GetPixel(i0, j0);
+			const Vec4& c2 = texture.GetPixel(i1, j0);
+			const Vec4& c3 = texture.GetPixel(i0, j1);
+			const Vec4& c4 = texture.GetPixel(i1, j1);
 
 			// weighted average of the 4
 			return c1 * (1 - alpha) * (1 - beta) +
@@ -221,6 +267,57 @@ public:
 				c4 * alpha * beta;
 		}
 
+		// the same filter as BiLinearSample on packed texels
+		// returns r, g, b, a in 32 bit lanes, 0 to 255 scaled up by 256
+		inline __m128i BiLinearSampleFixed(const Surface& texture, const Vec2& texel) const {
+
+			float s = texel.s - (int)(texel.s - WRAP_OFFSET);
+			float t = texel.t - (int)(texel.t - WRAP_OFFSET);
+
+			float u = texture.GetWidth() * s - 0.5f;
+			float v = texture.GetHeight() * t - 0.5f;
+
+			int i = (int)floorf(u);
+			int j = (int)floorf(v);
+
+			// weights out of 256
+			int alpha = (int)((u - i) * 256);
+			int beta = (int)((v - j) * 256);
+
+			int i0 = Clamp(i, texture.GetWidth());
+			int j0 = Clamp(j, texture.GetHeight());
+			int i1 = Clamp(i + 1, texture.GetWidth());
+			int j1 = Clamp(j + 1, texture.GetHeight());
+
+			__m128i zero = _mm_setzero_si128();
+
+			// left and right texels interleaved by channel and widened to 16 bits
+			// r1 r2 g1 g2 b1 b2 a1 a2
+			__m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texture.GetTexel(i0, j0)), _mm_cvtsi32_si128(texture.GetTexel(i1, j0))), zero);
+			__m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texture.GetTexel(i0, j1)), _mm_cvtsi32_si128(texture.GetTexel(i1, j1))), zero);
+
+			// multiply each pair by 256 - alpha, alpha and add, giving each row in 32 bits
+			__m128i weightsX = _mm_set1_epi32(alpha << 16 | (256 - alpha));
+			__m128i rowTop = _mm_madd_epi16(top, weightsX);
+			__m128i rowBottom = _mm_madd_epi16(bottom, weightsX);
+
+			// top + (bottom - top) * beta
+			return _mm_add_epi32(rowTop, _mm_srai_epi32(_mm_mullo_epi32(_mm_sub_epi32(rowBottom, rowTop), _mm_set1_epi32(beta)), 8));
+		}
+
+		// a + (b - a) * weight, weight out of 256
+		static inline __m128i LerpFixed(__m128i a, __m128i b, int weight) {
+			return _mm_add_epi32(a, _mm_srai_epi32(_mm_mullo_epi32(_mm_sub_epi32(b, a), _mm_set1_epi32(weight)), 8));
+		}
+
+		static inline Vec4 FixedToVec4(__m128i color) {
+
+			Vec4 result;
+			_mm_storeu_ps((float*)&result, _mm_mul_ps(_mm_cvtepi32_ps(color), _mm_set1_ps(1.0f / (255 * 256))));
+
+			return result;
+		}
+
 	public:
 
 		// if flat top is true, the pixels are left, bottom, right
@@ -293,7 +390,7 @@ public:
 				float densityY = sqrt(dudy * dudy + dvdy * dvdy);
 
 				// log2 of the greatest density is the mip map level
-				float mipMapLod = logf(fmaxf(densityX, densityY)) + 0.5;
+				float mipMapLod = log2f(fmaxf(densityX, densityY)) + 0.5f;
 			
 				textureToSample = texture.GetMipMap((int)mipMapLod);
 
@@ -304,6 +401,14 @@ public:
 					const Surface* mm1 = texture.GetMipMap((int)mipMapLod);
 					const Surface* mm2 = texture.GetMipMap((int)mipMapLod + 1);
 
+#ifdef FIXED_POINT_SAMPLING
+					if (parentRenderer.flags & RF_BILINEAR) {
+
+						int lodWeight = (int)((mipMapLod - (int)mipMapLod) * 256);
+						return FixedToVec4(LerpFixed(BiLinearSampleFixed(*mm1, texel1), BiLinearSampleFixed(*mm2, texel1), lodWeight));
+					}
+#endif
+
 					// sample the mip maps
 					Vec4 mm1Sample = parentRenderer.flags & RF_BILINEAR ? BiLinearSample(*mm1, texel1) : LinearSample(*mm1, texel1);
 					Vec4 mm2Sample = parentRenderer.flags & RF_BILINEAR ? BiLinearSample(*mm2, texel1) : LinearSample(*mm2, texel1);
@@ -315,6 +420,11 @@ public:
 				}
 			}
 
+#ifdef FIXED_POINT_SAMPLING
+			if (parentRenderer.flags & RF_BILINEAR)
+				return FixedToVec4(BiLinearSampleFixed(*textureToSample, texel1));
+#endif
+
 			// if bilinear sampling is enabled
 			return parentRenderer.flags & RF_BILINEAR ? BiLinearSample(*textureToSample, texel1) : LinearSample(*textureToSample, texel1);
 
@@ -396,6 +506,36 @@ public:
 	template <class Pixel>
 	using PS_TYPE = Vec4(*)(Pixel & sd, const Sampler<Pixel> & sampler);
 
+	// shaders that are also passed the draw's uniform block, see DrawElementArray
+	template <class Vertex, class Pixel, class Uniforms>
+	using UNIFORM_VS_TYPE = Pixel(*)(Vertex& v, const Uniforms& uniforms);
+
+	template <class Pixel, class Uniforms>
+	using UNIFORM_PS_TYPE = Vec4(*)(Pixel & sd, const Uniforms & uniforms, const Sampler<Pixel> & sampler);
+
+	// draws recorded by one renderer to be rasterized later, by any renderer
+	// the vertex shaders run while recording, so a recorded draw keeps the
+	// transforms of the frame it was recorded in and only rasterizes when executed
+	class CommandList {
+
+		friend class Renderer;
+
+	private:
+
+		std::vector<std::function<void(Renderer&)>> commands;
+
+	public:
+
+		// anything that has to run in order with the draws,
+		// it is called with the renderer executing the list
+		void Record(const std::function<void(Renderer&)>& command);
+
+		void Clear();
+		bool IsEmpty() const;
+		int Size() const;
+
+	};
+
 private:
 
 	Surface* pRenderTarget;
@@ -406,6 +546,19 @@ private:
 	// a renderer thread is working
 	volatile unsigned short flags = 0;
 
+	// draws go here instead of being drawn while it is set
+	CommandList* pRecording = nullptr;
+
+	// recorded draws go into this renderer instead of the one executing the list
+	Renderer* pRecordingTarget = nullptr;
+
+	// the last draw, and everything since ResetStatistics
+	PipelineStatistics drawStatistics;
+	PipelineStatistics statistics;
+
+	// where the drawing thread is counting
+	static thread_local PipelineStatistics* pStatisticsShard;
+
 	enum {
 		X_OFFSET = 0,
 		Y_OFFSET = 1,
@@ -494,6 +647,7 @@ private:
 				if (p3Outside) {
 					
 					//all points outside
+					COUNT_STATISTIC(trianglesOutside, 1);
 					return;
 				}
 				else {
@@ -560,6 +714,9 @@ private:
 		
 		Pixel n1 = Lerp(outside, inside1, alpha1);
 		Pixel n2 = Lerp(outside, inside2, alpha2);
+
+		COUNT_STATISTIC(trianglesClipped, 1);
+		COUNT_STATISTIC(clipperTriangles, 2);
 		
 		ClipAndDrawTriangle<Pixel, PSPtr>(n1, inside1, inside2, PixelShader, nextIteration);
 		ClipAndDrawTriangle<Pixel, PSPtr>(n1, inside2, n2, PixelShader, nextIteration);
@@ -582,6 +739,9 @@ private:
 		
 		Pixel n1 = Lerp(outside1, inside, alpha1);
 		Pixel n2 = Lerp(outside2, inside, alpha2);
+
+		COUNT_STATISTIC(trianglesClipped, 1);
+		COUNT_STATISTIC(clipperTriangles, 1);
 		
 		ClipAndDrawTriangle<Pixel, PSPtr>(n1, n2, inside, PixelShader, nextIteration);
 
@@ -608,6 +768,8 @@ private:
 
 	template <class Pixel, typename PSPtr>
 	void DrawTriangle(Pixel p1, Pixel p2, Pixel p3, PSPtr PixelShader) {
+
+		PROFILE_TIME(PROFILE_RASTERIZATION);
 		
 		// w divide
 		p1.WDivide();
@@ -624,10 +786,14 @@ private:
 			// a positive z value would be pointing away from the camera,
 			// but the handedness of the coordinate system was reversed
 			// in the perspective projection, so we check  < 0
-			if ((p1p2 % p1p3).z < 0)
+			if ((p1p2 % p1p3).z < 0) {
+				COUNT_STATISTIC(trianglesCulled, 1);
 				return;
+			}
 		}
 
+		COUNT_STATISTIC(trianglesRasterized, 1);
+
 		//calculate pixel coordinates
 
 		// all of these casts are to get rid of compiler warnings, here is what is actually happening
@@ -832,6 +998,8 @@ private:
 				if (TestAndSetPixel(x, y, normalizedDepth) && pRenderTarget) {
 
 					// run the pixel shader
+					PROFILE_TIME(PROFILE_PIXEL_SHADING);
+					COUNT_STATISTIC(pixelShaderInvocations, 1);
 					Vec4 pixelColor = PixelShader(acrossTravelerPixel, sampler2d);
 					pRenderTarget->PutPixel(x, y, pixelColor);
 
@@ -854,30 +1022,44 @@ private:
 
 	bool TestAndSetPixel(int x, int y, float normalizedDepth);
 
-	template <class Vertex, class Pixel, typename VSPtr, typename PSPtr>
-	void DEA_Thread(int idxStart, int numIdx, int* indices, Vertex* vertices, VSPtr VertexShader, PSPtr PixelShader)
+	template <class Vertex, class Pixel, class Index, typename VSPtr, typename PSPtr>
+	void DEA_Thread(int idxStart, int numIdx, const Index* indices, Vertex* vertices, VSPtr VertexShader, PSPtr PixelShader, PipelineStatistics* shard)
 	{
+		pStatisticsShard = shard;
+
 		// holds vertex shader results in case they are needed again
 		std::unordered_map<int, Pixel> processedVertices;
 		processedVertices.reserve(numIdx * 3);
 
-		// loop through all triangles assigned to this thread
-		for ( int i = idxStart; i < idxStart + numIdx; ++i ) {
+		// shade every vertex first, so each stage shows up on its own in the profiler
+		{
+			PROFILE_SCOPE("Vertex Shading");
 
-			int i1 = indices[i * 3];
-			int i2 = indices[i * 3 + 1];
-			int i3 = indices[i * 3 + 2];
+			for ( int i = idxStart * 3; i < (idxStart + numIdx) * 3; ++i ) {
 
-			// run the vertex shaders or look up the vertex if it has already been run
-			if ( !processedVertices.count(i1) ) {
-				processedVertices.emplace(i1, VertexShader(vertices[i1]));
-			}
-			if ( !processedVertices.count(i2) ) {
-				processedVertices.emplace(i2, VertexShader(vertices[i2]));
-			}
-			if ( !processedVertices.count(i3) ) {
-				processedVertices.emplace(i3, VertexShader(vertices[i3]));
+				int index = (int)indices[i];
+
+				// run the vertex shader unless it has already been run
+				if ( !processedVertices.count(index) ) {
+					processedVertices.emplace(index, VertexShader(vertices[index]));
+				}
 			}
+		}
+
+		// recorded draws were vertex shaded, and counted, when they were recorded
+		if ( RunsVertexShader<Pixel>(VertexShader) )
+			COUNT_STATISTIC(vertexShaderInvocations, (long long)processedVertices.size());
+
+		COUNT_STATISTIC(trianglesSubmitted, numIdx);
+
+		PROFILE_STAGES("Clip and Rasterize");
+
+		// loop through all triangles assigned to this thread
+		for ( int i = idxStart; i < idxStart + numIdx; ++i ) {
+
+			int i1 = (int)indices[i * 3];
+			int i2 = (int)indices[i * 3 + 1];
+			int i3 = (int)indices[i * 3 + 2];
 
 			// draw the triangle
 			ClipAndDrawTriangle<Pixel, PSPtr>(processedVertices[i1], processedVertices[i2], processedVertices[i3], PixelShader, NEAR);
@@ -885,17 +1067,19 @@ private:
 		}
 	}
 
-	template <class Vertex, class Pixel, typename VSPtr, typename PSPtr>
-	void DEA_Launcher(int numIndexGroups, int* indices, Vertex* vertices, VSPtr VertexShader, PSPtr PixelShader) {
+	template <class Vertex, class Pixel, class Index, typename VSPtr, typename PSPtr>
+	void DEA_Launcher(int numIndexGroups, const Index* indices, Vertex* vertices, VSPtr VertexShader, PSPtr PixelShader) {
 
 		//INVARIANTS
 
 		// depth buffer size must equal render target size, if there is a render target
-		assert(!(pRenderTarget != nullptr && (pRenderTarget->GetWidth() != depthBuffer.width || pRenderTarget->GetHeight() != depthBuffer.height)));
+		assert(!(pRenderTarget != nullptr && (pRenderTarget->GetWidth() != depthBuffer.GetWidth() || pRenderTarget->GetHeight() != depthBuffer.GetHeight())));
 
 		// in case someone has a processor from another planet
 		assert(NUM_THREADS <= MAX_SUPPORTED_THREADS);
 
+		// one for each thread, and one for this thread
+		PipelineStatistics shards[MAX_SUPPORTED_THREADS + 1];
 
 
 		if ( NUM_THREADS <= numIndexGroups ) {
@@ -911,28 +1095,31 @@ private:
 
 			// use each thread, and tell it to draw its share of the triangles
 			for ( int i = 0; i < NUM_THREADS * idxRange; i += idxRange ) {
-				threads[threadsUsed++] =
+				threads[threadsUsed] =
 					std::thread(
-						&Renderer::DEA_Thread<Vertex, Pixel, VSPtr, PSPtr>,
+						&Renderer::DEA_Thread<Vertex, Pixel, Index, VSPtr, PSPtr>,
 						this,
 						i,
 						idxRange,
 						indices,
 						vertices,
 						VertexShader,
-						PixelShader
+						PixelShader,
+						&shards[threadsUsed]
 					);
+				++threadsUsed;
 			}
 
 			// the leftover triangles (division remainder) will be drawn on this thread
-			DEA_Thread<Vertex, Pixel, VSPtr, PSPtr>
+			DEA_Thread<Vertex, Pixel, Index, VSPtr, PSPtr>
 				(
 					numIndexGroups - (numIndexGroups % NUM_THREADS), 
 					numIndexGroups % NUM_THREADS, 
 					indices, 
 					vertices, 
 					VertexShader, 
-					PixelShader
+					PixelShader,
+					&shards[MAX_SUPPORTED_THREADS]
 				);
 
 			// clean up the threads
@@ -950,28 +1137,31 @@ private:
 
 			// send a single triangle to each thread 
 			for ( int i = 0; i < numIndexGroups - 1; ++i ) {
-				threads[threadsUsed++] =
+				threads[threadsUsed] =
 					std::thread(
-						&Renderer::DEA_Thread<Vertex, Pixel, VSPtr, PSPtr>,
+						&Renderer::DEA_Thread<Vertex, Pixel, Index, VSPtr, PSPtr>,
 						this,
 						i,
 						1,
 						indices,
 						vertices,
 						VertexShader,
-						PixelShader
+						PixelShader,
+						&shards[threadsUsed]
 					);
+				++threadsUsed;
 			}
 
 			// draw the last triangle on this thread
-			DEA_Thread<Vertex, Pixel, VSPtr, PSPtr>
+			DEA_Thread<Vertex, Pixel, Index, VSPtr, PSPtr>
 				(
 					numIndexGroups - 1,
 					1,
 					indices,
 					vertices,
 					VertexShader,
-					PixelShader
+					PixelShader,
+					&shards[MAX_SUPPORTED_THREADS]
 					);
 
 			// clean up the threads
@@ -982,10 +1172,115 @@ private:
 		else {
 
 			// if there are no threads, draw the whole model in a single draw call
-			DEA_Thread<Vertex, Pixel, VSPtr, PSPtr>(0, numIndexGroups, indices, vertices, VertexShader, PixelShader);
+			DEA_Thread<Vertex, Pixel, Index, VSPtr, PSPtr>(0, numIndexGroups, indices, vertices, VertexShader, PixelShader, &shards[MAX_SUPPORTED_THREADS]);
+
+		}
+
+#ifdef PIPELINE_STATISTICS
+		drawStatistics = PipelineStatistics();
+
+		for ( const PipelineStatistics& shard : shards )
+			drawStatistics += shard;
+
+		statistics += drawStatistics;
+#endif
+
+	}
 
+	// vertex shader for recorded draws, their vertices are already shaded
+	template <class Pixel>
+	static Pixel ShadedVertex(Pixel& pixel) {
+		return pixel;
+	}
+
+	template <class Pixel, typename VSPtr>
+	static bool RunsVertexShader(VSPtr VertexShader) {
+
+		if constexpr (std::is_same<VSPtr, VS_TYPE<Pixel, Pixel>>::value)
+			return VertexShader != &ShadedVertex<Pixel>;
+		else
+			return true;
+	}
+
+	template <class Vertex, class Pixel, class Index, typename VSPtr, typename PSPtr>
+	void RecordElementArray(int numIndexGroups, const Index* indices, Vertex* vertices, VSPtr VertexShader, PSPtr PixelShader) {
+
+		// copies are kept so the caller can change its arrays as soon as this returns
+		auto recordedIndices = std::make_shared<std::vector<Index>>(indices, indices + numIndexGroups * 3);
+
+		int maxIndex = -1;
+		for (Index i : *recordedIndices)
+			maxIndex = std::max(maxIndex, (int)i);
+
+		// only the vertices the indices use are shaded, numbered in the order they are first used,
+		// coarse levels of detail share the full vertex buffer but use few of its vertices
+		std::vector<int> remap(maxIndex + 1, -1);
+		std::vector<int> usedVertices;
+
+		for (Index& i : *recordedIndices) {
+
+			if (remap[i] == -1) {
+				remap[i] = (int)usedVertices.size();
+				usedVertices.push_back((int)i);
+			}
+
+			i = (Index)remap[i];
 		}
 
+		int numVertices = (int)usedVertices.size();
+		auto shadedVertices = std::make_shared<std::vector<Pixel>>(numVertices);
+
+		PROFILE_SCOPE("Vertex Shading");
+
+		ParallelBands(numVertices, numVertices >= PARALLEL_VERTICES, [&](int first, int last) {
+			for (int v = first; v < last; ++v)
+				(*shadedVertices)[v] = VertexShader(vertices[usedVertices[v]]);
+		});
+
+#ifdef PIPELINE_STATISTICS
+		drawStatistics = PipelineStatistics();
+		drawStatistics.vertexShaderInvocations = numVertices;
+
+		// redirected draws are counted by their target when they are executed
+		if (pRecordingTarget == nullptr)
+			statistics += drawStatistics;
+#endif
+
+		unsigned short recordedFlags = flags;
+		Renderer* pTarget = pRecordingTarget;
+
+		pRecording->commands.emplace_back([=](Renderer& renderer) {
+
+			// drawn into the target with its own flags
+			if (pTarget != nullptr) {
+
+				pTarget->DEA_Launcher<Pixel, Pixel, Index, VS_TYPE<Pixel, Pixel>, PSPtr>
+					(
+						numIndexGroups,
+						recordedIndices->data(),
+						shadedVertices->data(),
+						ShadedVertex<Pixel>,
+						PixelShader
+					);
+
+				return;
+			}
+
+			// draw with the flags that were set when it was recorded
+			unsigned short executeFlags = renderer.flags;
+			renderer.flags = recordedFlags;
+
+			renderer.DEA_Launcher<Pixel, Pixel, Index, VS_TYPE<Pixel, Pixel>, PSPtr>
+				(
+					numIndexGroups,
+					recordedIndices->data(),
+					shadedVertices->data(),
+					ShadedVertex<Pixel>,
+					PixelShader
+				);
+
+			renderer.flags = executeFlags;
+		});
 	}
 
 public:
@@ -996,10 +1291,18 @@ public:
 
 	void SetRenderTarget(Surface& renderTarget);
 
-	template <class Vertex, class Pixel>
-	void DrawElementArray(int numIndexGroups, int* indices, Vertex* vertices, VS_TYPE<Vertex, Pixel> VertexShader, PS_TYPE<Pixel> PixelShader) {
+	// indices can be 32 bit ints, or 16 bit unsigned shorts for meshes with at most 65536 vertices
+	template <class Vertex, class Pixel, class Index>
+	void DrawElementArray(int numIndexGroups, const Index* indices, Vertex* vertices, VS_TYPE<Vertex, Pixel> VertexShader, PS_TYPE<Pixel> PixelShader) {
+
+		static_assert(std::is_same<Index, int>::value || std::is_same<Index, unsigned short>::value, "Indices must be int or unsigned short");
+
+		if (pRecording != nullptr) {
+			RecordElementArray<Vertex, Pixel, Index>(numIndexGroups, indices, vertices, VertexShader, PixelShader);
+			return;
+		}
 
-		DEA_Launcher<Vertex, Pixel, VS_TYPE<Vertex, Pixel>, PS_TYPE<Pixel>>
+		DEA_Launcher<Vertex, Pixel, Index, VS_TYPE<Vertex, Pixel>, PS_TYPE<Pixel>>
 			(
 				numIndexGroups, 
 				indices, 
@@ -1009,6 +1312,39 @@ public:
 			);
 	}
 
+	// uniforms holds what is the same for the whole draw, like matrix products and
+	// inverses, so it is computed once by the caller instead of once per vertex.
+	// every shader invocation is passed the same block, and recorded draws keep a
+	// copy of it, so the caller can change or free it as soon as this returns
+	template <class Vertex, class Pixel, class Uniforms, class Index>
+	void DrawElementArray(int numIndexGroups, const Index* indices, Vertex* vertices, const Uniforms& uniforms, UNIFORM_VS_TYPE<Vertex, Pixel, Uniforms> VertexShader, UNIFORM_PS_TYPE<Pixel, Uniforms> PixelShader) {
+
+		static_assert(std::is_same<Index, int>::value || std::is_same<Index, unsigned short>::value, "Indices must be int or unsigned short");
+
+		if (pRecording != nullptr) {
+
+			// the pixel shaders run when the list is executed
+			auto recordedUniforms = std::make_shared<Uniforms>(uniforms);
+
+			RecordElementArray<Vertex, Pixel, Index>(numIndexGroups, indices, vertices,
+				[=](Vertex& v) { return VertexShader(v, *recordedUniforms); },
+				[=](Pixel& p, const Sampler<Pixel>& sampler) { return PixelShader(p, *recordedUniforms, sampler); }
+			);
+			return;
+		}
+
+		const Uniforms* pUniforms = &uniforms;
+
+		DEA_Launcher<Vertex, Pixel, Index>
+			(
+				numIndexGroups,
+				indices,
+				vertices,
+				[=](Vertex& v) { return VertexShader(v, *pUniforms); },
+				[=](Pixel& p, const Sampler<Pixel>& sampler) { return PixelShader(p, *pUniforms, sampler); }
+			);
+	}
+
 	DepthBuffer& GetDepthBuffer();
 	const DepthBuffer& GetDepthBuffer() const;
 	void ClearDepthBuffer();
@@ -1020,4 +1356,27 @@ public:
 
 	Surface& GetRenderTarget();
 
+	// until EndRecording, draws are added to list instead of being drawn
+	void BeginRecording(CommandList& list);
+	void EndRecording();
+	bool IsRecording() const;
+
+	// while recording, the next draws are drawn into target with target's flags when the
+	// list is executed, like a light's shadow map, nullptr goes back to the executing renderer
+	void SetRecordingTarget(Renderer* target);
+
+	// runs command with this renderer now, or while recording adds it to the list,
+	// so it runs in order with the recorded draws on whichever thread executes the list
+	void RunInOrder(const std::function<void(Renderer&)>& command);
+
+	// draws everything in list into this renderer's target
+	void Execute(const CommandList& list);
+
+	// counts from the last draw, or from recording it
+	const PipelineStatistics& GetDrawStatistics() const;
+
+	// counts from every draw since the last reset, the render loops reset them every frame
+	const PipelineStatistics& GetStatistics() const;
+	void ResetStatistics();
+
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Shapes.h"
 #include "Mat4.h"
+#include <math.h>
 
 #define PI 3.14159265358979323846
 
@@ -27,26 +28,29 @@ static void MakeSphere(int vertsDown, float radius, int* numTriangles, int* numV
 	// store top as the first vertex
 	*vertices[0] = top;
 
-	// i loops down the sphere
-	for (int i = 0; i < vertsDown; ++i) {
+	// one line of vertices from top to bottom, the z rotation must be applied first
+	Vec4* meridian = new Vec4[vertsDown];
 
-		// the z rotation multiplication must be applied first
-		float rotz = (i + 1) * radianGap;
-		Vec4 down = Mat4::GetRotation(0, 0, rotz) * top;
+	for (int i = 0; i < vertsDown; ++i)
+		meridian[i] = Mat4::GetRotation(0, 0, (i + 1) * radianGap) * top;
 
-		// j loops around the sphere
-		for (int j = 0; j < vertsAround; ++j) {
+	Vec4* rotated = new Vec4[vertsDown];
 
-			float roty = (j + 1) * radianGap;
+	// every vertex at the same angle around the sphere is the meridian rotated
+	// by the same matrix, so each angle is one batch of vertsDown points
+	for (int j = 0; j < vertsAround; ++j) {
 
-			// generate the position
-			Vec4 vertex = Mat4::GetRotation(0, roty, 0) * down;
+		float roty = (j + 1) * radianGap;
 
-			(*vertices)[1 + count] = vertex;
-			++count;
-		}
+		TransformPoints(Mat4::GetRotation(0, roty, 0), meridian, rotated, vertsDown);
+
+		for (int i = 0; i < vertsDown; ++i)
+			(*vertices)[1 + i * vertsAround + j] = rotated[i];
 	}
 
+	delete[] meridian;
+	delete[] rotated;
+
 	// store bottom as the last vertex
 	(*vertices)[*numVertices - 1] = bottom;
 
@@ -161,3 +165,143 @@ Sphere::~Sphere() {
 
 }
 
+
+/////// AABB ////////
+
+AABB::AABB() : min(0, 0, 0), max(0, 0, 0) {}
+
+AABB::AABB(const Vec3& min, const Vec3& max) : min(min), max(max) {}
+
+AABB AABB::Union(const AABB& box) const {
+
+	return {
+		{ fminf(min.x, box.min.x), fminf(min.y, box.min.y), fminf(min.z, box.min.z) },
+		{ fmaxf(max.x, box.max.x), fmaxf(max.y, box.max.y), fmaxf(max.z, box.max.z) }
+	};
+
+}
+
+AABB AABB::Expanded(float margin) const {
+
+	Vec3 m(margin, margin, margin);
+	return { min - m, max + m };
+
+}
+
+AABB AABB::Transformed(const Mat4& transform) const {
+
+	// Arvo's method, each column of the matrix contributes its
+	// smallest and largest product with the box to the new bounds
+	// "Transforming Axis-Aligned Bounding Boxes", Graphics Gems
+
+	Vec3 newMin(transform(0, 3), transform(1, 3), transform(2, 3));
+	Vec3 newMax = newMin;
+
+	const float* oldMin = &min.x;
+	const float* oldMax = &max.x;
+
+	float* outMin = &newMin.x;
+	float* outMax = &newMax.x;
+
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 3; ++c) {
+
+			float a = transform(r, c) * oldMin[c];
+			float b = transform(r, c) * oldMax[c];
+
+			outMin[r] += fminf(a, b);
+			outMax[r] += fmaxf(a, b);
+
+		}
+	}
+
+	return { newMin, newMax };
+
+}
+
+bool AABB::Contains(const AABB& box) const {
+
+	return min.x <= box.min.x && min.y <= box.min.y && min.z <= box.min.z &&
+		max.x >= box.max.x && max.y >= box.max.y && max.z >= box.max.z;
+
+}
+
+bool AABB::Overlaps(const AABB& box) const {
+
+	return min.x <= box.max.x && max.x >= box.min.x &&
+		min.y <= box.max.y && max.y >= box.min.y &&
+		min.z <= box.max.z && max.z >= box.min.z;
+
+}
+
+float AABB::SurfaceArea() const {
+
+	Vec3 d = max - min;
+	return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+
+}
+
+Vec3 AABB::Center() const {
+	return (min + max) * 0.5f;
+}
+
+Vec3 AABB::Extents() const {
+	return (max - min) * 0.5f;
+}
+
+AABB AABB::FromPoints(int numPoints, const Vec4* points, int stride) {
+
+	// stride is in bytes, so the points can live inside of vertex structures
+
+	if (numPoints <= 0)
+		return {};
+
+	AABB box(points->Vec3(), points->Vec3());
+
+	for (int i = 1; i < numPoints; ++i) {
+
+		const Vec4& p = *(const Vec4*)((const char*)points + i * stride);
+
+		box.min = { fminf(box.min.x, p.x), fminf(box.min.y, p.y), fminf(box.min.z, p.z) };
+		box.max = { fmaxf(box.max.x, p.x), fmaxf(box.max.y, p.y), fmaxf(box.max.z, p.z) };
+	}
+
+	return box;
+
+}
+
+/////// PLANE ////////
+
+float Plane::Distance(const Vec3& point) const {
+	return normal * point + d;
+}
+
+void ExtractFrustumPlanes(const Mat4& viewProjection, Plane planes[6]) {
+
+	// Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+	// a point is inside when -w <= x, y, z <= w, the same test the renderer clips with
+
+	Vec4 rows[4];
+	for (int r = 0; r < 4; ++r)
+		rows[r] = { viewProjection(r, 0), viewProjection(r, 1), viewProjection(r, 2), viewProjection(r, 3) };
+
+	Vec4 combined[6] = {
+		rows[3] + rows[2],
+		rows[3] - rows[2],
+		rows[3] + rows[0],
+		rows[3] - rows[0],
+		rows[3] + rows[1],
+		rows[3] - rows[1]
+	};
+
+	for (int i = 0; i < 6; ++i) {
+
+		// normalize so distances are in world units
+		float length = combined[i].Vec3().Length();
+
+		planes[i].normal = combined[i].Vec3() / length;
+		planes[i].d = combined[i].w / length;
+
+	}
+
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "Vec4.h"
+#include "Vec3.h"
+
+class Mat4;
 
 struct Box {
 
@@ -12,6 +15,41 @@ struct Box {
 
 };
 
+// axis aligned bounding box
+struct AABB {
+
+	Vec3 min;
+	Vec3 max;
+
+	AABB();
+	AABB(const Vec3& min, const Vec3& max);
+
+	AABB Union(const AABB& box) const;
+	AABB Expanded(float margin) const;
+	AABB Transformed(const Mat4& transform) const;
+
+	bool Contains(const AABB& box) const;
+	bool Overlaps(const AABB& box) const;
+
+	float SurfaceArea() const;
+
+	Vec3 Center() const;
+	Vec3 Extents() const;
+
+	static AABB FromPoints(int numPoints, const Vec4* points, int stride);
+
+};
+
+// plane in the form normal * p + d = 0, normal points inside
+struct Plane {
+
+	Vec3 normal;
+	float d;
+
+	float Distance(const Vec3& point) const;
+
+};
+
 struct Frustum {
 
 	float near;
@@ -26,6 +64,10 @@ struct Frustum {
 
 };
 
+// extracts the six clip planes from a view projection matrix
+// order is near, far, left, right, bottom, top
+void ExtractFrustumPlanes(const Mat4& viewProjection, Plane planes[6]);
+
 struct Sphere {
 
 	float radius;
@@ -2,79 +2,253 @@
 #include <memory>
 #include <SDL.h>
 #include "Images.h"
+#include "MappedFile.h"
+#include "TextureFile.h"
+#include "BlockCompression.h"
+#include "Utility.h"
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <immintrin.h>
+
+// each level in the mip pyramid starts on a cache line
+#define MIP_ALIGNMENT 64
+
+// 0 is never handed out, so empty cache entries never match
+static std::atomic<unsigned int> nextBlockCacheId(1);
+
+// intermediate image for blurs and resampling, kept per thread so filtering every frame does not allocate
+static int* GetScratchImage(int numPixels) {
+
+	thread_local std::vector<int> scratch;
+
+	if ((int)scratch.size() < numPixels)
+		scratch.resize(numPixels);
+
+	return scratch.data();
+
+}
 
 Surface::Surface(int width, int height) 
 	: 
-	width(width), height(height) 
+	TypedSurface<RGBA8>(width, height), pitch(width * 4)
 {
 
-	pPixels = new int[width * height];
-	allocatedSpace = width * height;
-
 	BlackOut();
 
-	pitch = width * 4;
-	aMask = 0xff000000;
-	bMask = 0x00ff0000;
-	gMask = 0x0000ff00;
-	rMask = 0x000000ff;
-
 	std::cout << "Allocating " << GetAllocationString() << " for Surface." << std::endl;
 
 }
 Surface::Surface(const Surface& surface)
 	: 
-	width(surface.width), height(surface.height), allocatedSpace(surface.allocatedSpace), pitch(surface.pitch), 
-	rMask(surface.rMask), gMask(surface.gMask), bMask(surface.bMask), aMask(surface.aMask) 
+	pitch(surface.pitch),
+	layout(surface.layout), mortonBits(surface.mortonBits),
+	compression(surface.compression), blockCacheId(surface.blockCacheId)
 {
 
-	if (pPixels != nullptr)
-		delete[] pPixels;
+	width = surface.width;
+	height = surface.height;
 
-	pPixels = new int[width * height];
+	// compressed surfaces hold fewer ints than pixels
+	allocatedSpace = GetBufferSize() / sizeof(int);
+
+	pPixels = new int[allocatedSpace];
 	memcpy((void*)pPixels, (void*)surface.pPixels, GetBufferSize());
 
 	std::cout << "Allocating " << GetAllocationString() << " for Surface." << std::endl;
 
 }
-Surface::Surface(Surface&& surface) noexcept :
-	width(surface.width), height(surface.height), allocatedSpace(surface.allocatedSpace), pitch(surface.pitch),
-	rMask(surface.rMask), gMask(surface.gMask), bMask(surface.bMask), aMask(surface.aMask), pPixels(surface.pPixels)
+Surface::Surface(Surface&& surface) noexcept 
+	:
+	TypedSurface<RGBA8>(std::move(surface)), pitch(surface.pitch),
+	mipMap(surface.mipMap), mapping(surface.mapping), ownsPixels(surface.ownsPixels), mipPyramid(surface.mipPyramid), mipPyramidSize(surface.mipPyramidSize),
+	layout(surface.layout), mortonBits(surface.mortonBits),
+	compression(surface.compression), blockCacheId(surface.blockCacheId)
 {
 
-	surface.pPixels = nullptr;
+	surface.mipMap = nullptr;
+	surface.mapping = nullptr;
+	surface.mipPyramid = nullptr;
+}
+
+Surface::Surface(int* pixels, int width, int height, const Surface& format)
+	:
+	pitch(width * 4), ownsPixels(false),
+	layout(format.layout), mortonBits(MortonBits(width, height)),
+	compression(format.compression), blockCacheId(nextBlockCacheId++)
+{
+
+	pPixels = pixels;
+	this->width = width;
+	this->height = height;
+	allocatedSpace = width * height;
 }
 
-Surface::Surface(const std::string& filename) {
+Surface::Surface(const std::string& filename, bool useTextureFile) {
+
+	if (useTextureFile) {
+
+		// the file is already a converted texture
+		const std::string extension = TEXTURE_FILE_EXTENSION;
+		bool isTexture = filename.size() > extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+
+		if (isTexture ? MapTextureFile(filename, "") : MapTextureFile(TextureFile::PathFor(filename), filename))
+			return;
+	}
 
 	pPixels = (int*)Images::Load(filename, &width, &height, BPP);
 	allocatedSpace = width * height;
 
 	pitch = width * 4;
-	aMask = 0xff000000;
-	bMask = 0x00ff0000;
-	gMask = 0x0000ff00;
-	rMask = 0x000000ff;
 
 	std::cout << "Allocating " << GetAllocationString() << " for Surface." << std::endl;
 
 }
 
+bool Surface::MapTextureFile(const std::string& texturePath, const std::string& sourcePath) {
+
+	MappedFile* file = new MappedFile();
+
+	// copy on write, so the pixels can still be drawn on without touching the file
+	if (!file->Open(texturePath, true)) {
+		delete file;
+		return false;
+	}
+
+	char* base = (char*)file->MutableData();
+	size_t size = file->Size();
+
+	const TextureFileHeader* header = (const TextureFileHeader*)base;
+	const TextureFileLevel* levels = (const TextureFileLevel*)(base + sizeof(TextureFileHeader));
+
+	bool valid = size >= sizeof(TextureFileHeader) &&
+		header->magic == TEXTURE_FILE_MAGIC &&
+		header->version == TEXTURE_FILE_VERSION &&
+		header->numLevels > 0 &&
+		header->rMask == RGBA8::R_MASK && header->gMask == RGBA8::G_MASK &&
+		header->bMask == RGBA8::B_MASK && header->aMask == RGBA8::A_MASK &&
+		size >= sizeof(TextureFileHeader) + header->numLevels * sizeof(TextureFileLevel);
+
+	// the texture must have been converted from the current version of the image
+	if (valid && !sourcePath.empty()) {
+
+		long long sourceSize, sourceModified;
+		valid = GetFileStamp(sourcePath, sourceSize, sourceModified) &&
+			header->sourceSize == sourceSize && header->sourceModified == sourceModified;
+	}
+
+	for (int l = 0; valid && l < header->numLevels; ++l) {
+
+		// morton textures must have power of two levels
+		// bytes this level takes up
+		long long levelSize = (long long)levels[l].width * levels[l].height * sizeof(int);
+		if (header->compression != SURFACE_UNCOMPRESSED)
+			levelSize = (long long)((levels[l].width + 3) / 4) * ((levels[l].height + 3) / 4) * BlockCompression::BlockBytes(header->compression);
+
+		valid = (header->layout == SURFACE_LINEAR || header->layout == SURFACE_MORTON && MortonBits(levels[l].width, levels[l].height) >= 0) &&
+			(header->compression == SURFACE_UNCOMPRESSED || header->layout == SURFACE_LINEAR && BlockCompression::BlockBytes(header->compression) > 0) &&
+			levels[l].width > 0 && levels[l].height > 0 && levels[l].offset % sizeof(int) == 0 &&
+			levels[l].offset + levelSize <= (long long)size;
+	}
+
+	if (!valid) {
+		delete file;
+		return false;
+	}
+
+	mapping = file;
+	ownsPixels = false;
+
+	pPixels = (int*)(base + levels[0].offset);
+	width = levels[0].width;
+	height = levels[0].height;
+	allocatedSpace = width * height;
+	pitch = width * 4;
+
+	layout = header->layout;
+	mortonBits = MortonBits(width, height);
+	compression = header->compression;
+	blockCacheId = nextBlockCacheId++;
+
+	// link up the stored mip chain
+	Surface* previous = this;
+	for (int l = 1; l < header->numLevels; ++l) {
+
+		previous->mipMap = new Surface((int*)(base + levels[l].offset), levels[l].width, levels[l].height, *this);
+		previous = previous->mipMap;
+	}
+
+	std::cout << "Mapping " << GetAllocationString() << " for Surface with " << header->numLevels << " levels." << std::endl;
+
+	return true;
+
+}
+
+void Surface::ReplacePixels(int* newPixels) {
+
+	if (ownsPixels && pPixels != nullptr)
+		delete[] pPixels;
+
+	pPixels = newPixels;
+	ownsPixels = true;
+
+}
+
+void Surface::RepackMipMaps() {
+
+	if (mipPyramid == nullptr)
+		return;
+
+	// nothing to do while every level still points into the pyramid
+	bool moved = false;
+	for (Surface* level = mipMap; level != nullptr; level = level->mipMap)
+		moved = moved || level->ownsPixels;
+
+	if (!moved)
+		return;
+
+	int size = 0;
+	for (Surface* level = mipMap; level != nullptr; level = level->mipMap)
+		size += (level->GetBufferSize() + MIP_ALIGNMENT - 1) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+
+	int* pyramid = (int*)_mm_malloc(size, MIP_ALIGNMENT);
+
+	int offset = 0;
+	for (Surface* level = mipMap; level != nullptr; level = level->mipMap) {
+
+		int* pixels = pyramid + offset / sizeof(int);
+		memcpy(pixels, level->pPixels, level->GetBufferSize());
+
+		level->ReplacePixels(pixels);
+		level->ownsPixels = false;
+
+		offset += (level->GetBufferSize() + MIP_ALIGNMENT - 1) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+	}
+
+	_mm_free(mipPyramid);
+	mipPyramid = pyramid;
+	mipPyramidSize = size;
+
+}
+
 Surface& Surface::operator=(const Surface& surface) {
 
+	if (this == &surface)
+		return *this;
+
 	width = surface.width;
 	height = surface.height;
-	allocatedSpace = surface.allocatedSpace;
 	pitch = surface.pitch;
-	rMask = surface.rMask;
-	gMask = surface.gMask;
-	bMask = surface.bMask;
-	aMask = surface.aMask;
+	layout = surface.layout;
+	mortonBits = surface.mortonBits;
+	compression = surface.compression;
+	blockCacheId = surface.blockCacheId;
 
-	if (pPixels != nullptr)
-		delete[] pPixels;
+	allocatedSpace = GetBufferSize() / sizeof(int);
 
-	pPixels = new int[width * height];
+	ReplacePixels(new int[allocatedSpace]);
 	memcpy((void*)pPixels, (void*)surface.pPixels, GetBufferSize());
 
 	return *this;
@@ -85,11 +259,20 @@ Surface& Surface::operator=(Surface&& surface) noexcept {
 	width = surface.width;
 	height = surface.height;
 	allocatedSpace = surface.allocatedSpace;
-	rMask = surface.rMask;
-	gMask = surface.gMask;
-	bMask = surface.bMask;
-	aMask = surface.aMask;
-	pPixels = surface.pPixels;
+	pitch = surface.pitch;
+	layout = surface.layout;
+	mortonBits = surface.mortonBits;
+	compression = surface.compression;
+	blockCacheId = surface.blockCacheId;
+
+	ReplacePixels(surface.pPixels);
+	ownsPixels = surface.ownsPixels;
+
+	// the mapping has to come along with any pixels that point into it
+	std::swap(mipMap, surface.mipMap);
+	std::swap(mapping, surface.mapping);
+	std::swap(mipPyramid, surface.mipPyramid);
+	std::swap(mipPyramidSize, surface.mipPyramidSize);
 
 	surface.pPixels = nullptr;
 
@@ -101,20 +284,15 @@ Surface::~Surface() {
 
 	std::cout << "Freeing " << GetAllocationString() << " for Surface" << std::endl;
 
-	if (pPixels != nullptr)
-		delete[] pPixels;
+	// owned pixels are freed by TypedSurface, the rest belong to a mapping or the mip pyramid
+	if (!ownsPixels)
+		pPixels = nullptr;
 
-	// do not call delete mip maps
-	if (mipMap != nullptr)
-		delete mipMap;
-}
+	DeleteMipMaps();
 
-int Surface::GetWidth() const {
-	return width;
-}
-
-int Surface::GetHeight() const {
-	return height;
+	// after the mip maps, which point into it
+	if (mapping != nullptr)
+		delete mapping;
 }
 
 const int* Surface::GetPixels() const {
@@ -126,39 +304,204 @@ int Surface::GetPitch() const {
 }
 
 int Surface::GetRMask() const {
-	return rMask;
+	return RGBA8::R_MASK;
 }
 
 int Surface::GetGMask() const {
-	return gMask;
+	return RGBA8::G_MASK;
 }
 
 int Surface::GetBMask() const {
-	return bMask;
+	return RGBA8::B_MASK;
 }
 
 int Surface::GetAMask() const {
-	return aMask;
+	return RGBA8::A_MASK;
 }
 
 int Surface::GetBufferSize() const {
 
+	if (compression != SURFACE_UNCOMPRESSED)
+		return ((width + 3) / 4) * ((height + 3) / 4) * BlockCompression::BlockBytes(compression);
+
 	return sizeof(int) * width * height;
 
 }
 
-void Surface::SetColorMasks(int aMask, int rMask, int gMask, int bMask) {
+size_t Surface::GetMemoryUsage() const {
+
+	size_t bytes = GetBufferSize() + mipPyramidSize;
+
+	// levels outside the pyramid, like those of a mapped texture, count on their own
+	for (const Surface* level = mipMap; level != nullptr; level = level->mipMap)
+		if (mipPyramid == nullptr || level->ownsPixels)
+			bytes += level->GetBufferSize();
+
+	return bytes;
+
+}
+
+int Surface::MortonBits(int width, int height) {
+
+	// both sides must be powers of two
+	if (width <= 0 || height <= 0 || (width & (width - 1)) || (height & (height - 1)))
+		return -1;
+
+	int bits = 0;
+	while ((2 << bits) <= width && (2 << bits) <= height)
+		++bits;
+
+	return bits;
+
+}
+
+bool Surface::SetLayout(int layout) {
+
+	int bits = MortonBits(width, height);
+
+	if (layout == SURFACE_MORTON && bits < 0)
+		return false;
+
+	// blocks are always stored in rows
+	if (layout != SURFACE_LINEAR && compression != SURFACE_UNCOMPRESSED)
+		return false;
+
+	if (layout != this->layout && pPixels != nullptr) {
+
+		int* newBuf = new int[width * height];
+
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				newBuf[PixelIndex(x, y, width, layout, bits)] = pPixels[PixelIndex(x, y)];
+
+		ReplacePixels(newBuf);
+	}
+
+	this->layout = layout;
+	mortonBits = bits;
+
+	bool levelsSet = mipMap == nullptr || mipMap->SetLayout(layout);
+
+	RepackMipMaps();
+
+	return levelsSet;
+
+}
+
+int Surface::GetLayout() const {
+	return layout;
+}
+
+void Surface::MakeEditable() {
+
+	Compress(SURFACE_UNCOMPRESSED);
+	SetLayout(SURFACE_LINEAR);
+
+}
+
+void Surface::Compress(int format) {
+
+	if (format != compression && pPixels != nullptr) {
+
+		// go through plain pixels between two compressed formats
+		if (compression != SURFACE_UNCOMPRESSED) {
+
+			int* pixels = new int[width * height];
+
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+					pixels[width * y + x] = DecodeTexel(x, y);
+
+			ReplacePixels(pixels);
+			compression = SURFACE_UNCOMPRESSED;
+		}
+
+		if (format != SURFACE_UNCOMPRESSED) {
+
+			SetLayout(SURFACE_LINEAR);
 
-	this->rMask = rMask;
-	this->gMask = gMask;
-	this->bMask = bMask;
-	this->aMask = aMask;
+			int blockBytes = BlockCompression::BlockBytes(format);
+			int blocksWide = (width + 3) / 4;
+			int blocksHigh = (height + 3) / 4;
+
+			unsigned char* blocks = (unsigned char*)new int[blocksWide * blocksHigh * blockBytes / sizeof(int)];
+
+			for (int by = 0; by < blocksHigh; ++by) {
+				for (int bx = 0; bx < blocksWide; ++bx) {
+
+					// blocks hanging off the edge repeat the last row and column
+					int block[16];
+					for (int i = 0; i < 16; ++i) {
+
+						int x = std::min(bx * 4 + i % 4, width - 1);
+						int y = std::min(by * 4 + i / 4, height - 1);
+
+						block[i] = pPixels[width * y + x];
+					}
+
+					BlockCompression::EncodeBlock(format, block, blocks + (by * blocksWide + bx) * blockBytes);
+				}
+			}
+
+			ReplacePixels((int*)blocks);
+			compression = format;
+			blockCacheId = nextBlockCacheId++;
+		}
+	}
+
+	if (mipMap != nullptr)
+		mipMap->Compress(format);
+
+	RepackMipMaps();
+
+}
+
+int Surface::GetCompression() const {
+	return compression;
+}
+
+int Surface::DecodeTexel(int x, int y) const {
+
+	struct CachedBlock {
+		unsigned int id;
+		int block;
+		int pixels[16];
+	};
+
+	// direct mapped, indexed by the block number
+	thread_local CachedBlock cache[BLOCK_CACHE_SIZE] = {};
+
+	int blocksWide = (width + 3) / 4;
+	int block = (y / 4) * blocksWide + x / 4;
+
+	CachedBlock& entry = cache[(block ^ blockCacheId * 31) % BLOCK_CACHE_SIZE];
+
+	if (entry.id != blockCacheId || entry.block != block) {
+
+		const unsigned char* blocks = (const unsigned char*)pPixels;
+		BlockCompression::DecodeBlock(compression, blocks + block * BlockCompression::BlockBytes(compression), entry.pixels);
+
+		entry.id = blockCacheId;
+		entry.block = block;
+	}
+
+	return entry.pixels[(y % 4) * 4 + x % 4];
 
 }
 
 void Surface::SaveToFile(const std::string& filename) const {
 
-	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom((void*)pPixels, width, height, BPP, pitch, rMask, gMask, bMask, aMask);
+	// SDL expects rows of pixels
+	if (layout != SURFACE_LINEAR || compression != SURFACE_UNCOMPRESSED) {
+
+		Surface linear(*this);
+		linear.MakeEditable();
+		linear.SaveToFile(filename);
+
+		return;
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom((void*)pPixels, width, height, BPP, pitch, RGBA8::R_MASK, RGBA8::G_MASK, RGBA8::B_MASK, RGBA8::A_MASK);
 	SDL_SaveBMP(surface, filename.c_str());
 	SDL_FreeSurface(surface);
 
@@ -166,6 +509,8 @@ void Surface::SaveToFile(const std::string& filename) const {
 
 void Surface::Resize(int width, int height, bool maintainImage) {
 
+	MakeEditable();
+
 	if ( width <= 0 || height <= 0 )
 		return;
 
@@ -178,40 +523,333 @@ void Surface::Resize(int width, int height, bool maintainImage) {
 		
 		if (maintainImage) {
 
-			// the original image should be maintained during the resize
+			// the original image should be maintained during the resize
+
+			int rowMin = height < this->height ? height : this->height;
+			int colMin = width < this->width ? width : this->width;
+
+			for (int row = 0; row < rowMin; ++row) {
+
+				int* startOfBufferRow = newBuf + width * row;
+				int* startOfThisRow = pPixels + this->width * row;
+
+				// copy row by row
+				memcpy(startOfBufferRow, startOfThisRow, colMin * sizeof(int));
+
+			}
+
+		}
+		else {
+
+			// they don't want to maintain the image,
+			// just copy everything over
+			memcpy(newBuf, pPixels, GetBufferSize());
+		}
+
+		ReplacePixels(newBuf);
+	}
+
+	this->width = width;
+	this->height = height;
+	pitch = width * 4;
+
+}
+
+// resampling weights are fixed point with this many fractional bits, small enough
+// that a weight fits in 16 bits for _mm_madd_epi16
+#define RESAMPLE_WEIGHT_BITS 14
+
+static float SincPi(float x) {
+
+	if (x == 0)
+		return 1;
+
+	x *= (float)PI;
+	return sinf(x) / x;
+
+}
+
+// the filter's value at x source pixels from the center, and how far out it reaches
+static float ResampleFilter(int filter, float x, float& radius) {
+
+	x = fabsf(x);
+
+	switch (filter) {
+
+	case Surface::FILTER_BICUBIC:
+
+		// Catmull-Rom, a = -0.5
+		radius = 2;
+
+		if (x < 1)
+			return 1.5f * x * x * x - 2.5f * x * x + 1;
+		if (x < 2)
+			return -0.5f * x * x * x + 2.5f * x * x - 4 * x + 2;
+		return 0;
+
+	case Surface::FILTER_LANCZOS:
+
+		radius = 3;
+		return x < 3 ? SincPi(x) * SincPi(x / 3) : 0;
+
+	default:
+
+		radius = 1;
+		return x < 1 ? 1 - x : 0;
+	}
+
+}
+
+// source pixels and weights for every pixel along one axis of the output
+// every output pixel reads the same number of neighboring source pixels
+struct ResampleTable {
+
+	int taps;
+
+	// first source pixel of each output pixel, the taps always stay inside the source
+	std::vector<int> starts;
+
+	// weights two taps at a time, packed as 16 bit halves for _mm_madd_epi16
+	// an odd last tap is paired with a zero weight
+	std::vector<int> weightPairs;
+
+	int pairs;
+
+	ResampleTable(int filter, int sourceSize, int size) {
+
+		float radius;
+		ResampleFilter(filter, 0, radius);
+
+		// shrinking widens the filter so every source pixel is covered
+		float scale = (float)size / sourceSize;
+		float filterScale = scale < 1 ? 1 / scale : 1;
+		float support = radius * filterScale;
+
+		// pixels whose centers are within support of the output pixel's center
+		int filterTaps = (int)ceilf(2 * support);
+		taps = std::min(filterTaps, sourceSize);
+		pairs = (taps + 1) / 2;
+
+		starts.resize(size);
+		weightPairs.resize(size * pairs);
+
+		std::vector<float> w(taps);
+
+		for (int i = 0; i < size; ++i) {
+
+			// output pixel centers mapped back into the source
+			float center = (i + 0.5f) / scale;
+			int first = (int)floorf(center - support - 0.5f) + 1;
+
+			// taps past the edges repeat the edge pixels, so their weight goes to the edge
+			starts[i] = std::min(std::max(first, 0), sourceSize - taps);
+			std::fill(w.begin(), w.end(), 0.0f);
+
+			float sum = 0;
+			for (int t = 0; t < filterTaps; ++t) {
+
+				float unused;
+				float weight = ResampleFilter(filter, (first + t + 0.5f - center) / filterScale, unused);
+
+				w[std::min(std::max(first + t, 0), sourceSize - 1) - starts[i]] += weight;
+				sum += weight;
+			}
+
+			// normalize in fixed point, rounding error goes to the largest weight
+			std::vector<short> fixed(pairs * 2, 0);
+			int fixedSum = 0;
+			int largest = 0;
+
+			for (int t = 0; t < taps; ++t) {
+
+				fixed[t] = (short)roundf(w[t] / sum * (1 << RESAMPLE_WEIGHT_BITS));
+				fixedSum += fixed[t];
+
+				if (w[t] > w[largest])
+					largest = t;
+			}
+
+			fixed[largest] += (1 << RESAMPLE_WEIGHT_BITS) - fixedSum;
+
+			for (int p = 0; p < pairs; ++p)
+				weightPairs[i * pairs + p] = (int)((unsigned short)fixed[2 * p] | (unsigned int)(unsigned short)fixed[2 * p + 1] << 16);
+		}
+	}
+
+};
+
+static inline int PackResampled(__m128i sum) {
+
+	sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1))), RESAMPLE_WEIGHT_BITS);
+	sum = _mm_packs_epi32(sum, sum);
+
+	return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+
+}
+
+// each output pixel loads its taps two at a time and interleaves the channels
+// of both pixels, so _mm_madd_epi16 weights and adds them in one instruction
+static void ResampleRowsHorizontal(const int* source, int sourceWidth, int* dest, int width, const ResampleTable& table, int firstRow, int lastRow) {
+
+	const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	int evenTaps = table.taps & ~1;
+
+	for (int r = firstRow; r < lastRow; ++r) {
+
+		const int* row = source + sourceWidth * r;
+		int* out = dest + width * r;
+
+		for (int c = 0; c < width; ++c) {
+
+			const int* pixels = row + table.starts[c];
+			const int* weightPairs = table.weightPairs.data() + c * table.pairs;
+
+			__m128i sum = _mm_setzero_si128();
+
+			int t = 0;
+			for (; t < evenTaps; t += 2) {
+
+				__m128i pair = _mm_cvtepu8_epi16(_mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)(pixels + t)), interleave));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, _mm_set1_epi32(weightPairs[t / 2])));
+			}
+
+			// the last tap pairs up with zeros
+			if (t < table.taps) {
+
+				__m128i pair = _mm_cvtepu8_epi16(_mm_shuffle_epi8(_mm_cvtsi32_si128(pixels[t]), interleave));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, _mm_set1_epi32(weightPairs[t / 2])));
+			}
+
+			out[c] = PackResampled(sum);
+		}
+	}
+
+}
+
+// whole rows are weighted together, 8 pixels at a time with the channels
+// of two source rows interleaved for _mm256_madd_epi16
+static void ResampleRowsVertical(const int* source, int width, int* dest, const ResampleTable& table, int firstRow, int lastRow) {
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(1 << (RESAMPLE_WEIGHT_BITS - 1));
+
+	for (int r = firstRow; r < lastRow; ++r) {
+
+		const int* first = source + width * table.starts[r];
+		const int* weightPairs = table.weightPairs.data() + r * table.pairs;
+
+		int* out = dest + width * r;
+
+		int c = 0;
+		for (; c + 8 <= width; c += 8) {
+
+			__m256i sums[4] = { zero, zero, zero, zero };
+
+			for (int t = 0; t < table.taps; t += 2) {
+
+				__m256i a = _mm256_loadu_si256((const __m256i*)(first + width * t + c));
+				__m256i b = t + 1 < table.taps ? _mm256_loadu_si256((const __m256i*)(first + width * (t + 1) + c)) : zero;
+				__m256i weightPair = _mm256_set1_epi32(weightPairs[t / 2]);
+
+				__m256i aLo = _mm256_unpacklo_epi8(a, zero);
+				__m256i aHi = _mm256_unpackhi_epi8(a, zero);
+				__m256i bLo = _mm256_unpacklo_epi8(b, zero);
+				__m256i bHi = _mm256_unpackhi_epi8(b, zero);
+
+				sums[0] = _mm256_add_epi32(sums[0], _mm256_madd_epi16(_mm256_unpacklo_epi16(aLo, bLo), weightPair));
+				sums[1] = _mm256_add_epi32(sums[1], _mm256_madd_epi16(_mm256_unpackhi_epi16(aLo, bLo), weightPair));
+				sums[2] = _mm256_add_epi32(sums[2], _mm256_madd_epi16(_mm256_unpacklo_epi16(aHi, bHi), weightPair));
+				sums[3] = _mm256_add_epi32(sums[3], _mm256_madd_epi16(_mm256_unpackhi_epi16(aHi, bHi), weightPair));
+			}
+
+			for (int i = 0; i < 4; ++i)
+				sums[i] = _mm256_srai_epi32(_mm256_add_epi32(sums[i], round), RESAMPLE_WEIGHT_BITS);
+
+			// the packs undo the unpacks lane by lane, so the pixels come out in order
+			__m256i lo = _mm256_packs_epi32(sums[0], sums[1]);
+			__m256i hi = _mm256_packs_epi32(sums[2], sums[3]);
+
+			_mm256_storeu_si256((__m256i*)(out + c), _mm256_packus_epi16(lo, hi));
+		}
+
+		for (; c < width; ++c) {
+
+			__m128i sum = _mm_setzero_si128();
+
+			for (int t = 0; t < table.taps; t += 2) {
+
+				int below = t + 1 < table.taps ? first[width * (t + 1) + c] : 0;
+
+				__m128i pair = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(first[width * t + c]), _mm_cvtsi32_si128(below)), _mm_setzero_si128());
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, _mm_set1_epi32(weightPairs[t / 2])));
+			}
+
+			out[c] = PackResampled(sum);
+		}
+	}
+
+}
+
+// scales source into dest, rows first then columns, each pass split across threads
+static void Resample(const int* source, int sourceWidth, int sourceHeight, int* dest, int width, int height, int filter) {
+
+	bool parallel = width * height >= PARALLEL_PIXELS;
+
+	if (filter == Surface::FILTER_NEAREST) {
+
+		std::vector<int> columns(width);
+		for (int c = 0; c < width; ++c)
+			columns[c] = std::min((int)((c + 0.5f) * sourceWidth / width), sourceWidth - 1);
+
+		ParallelBands(height, parallel, [&](int firstRow, int lastRow) {
+
+			for (int r = firstRow; r < lastRow; ++r) {
+
+				const int* row = source + sourceWidth * std::min((int)((r + 0.5f) * sourceHeight / height), sourceHeight - 1);
+				int* out = dest + width * r;
 
-			int rowMin = height < this->height ? height : this->height;
-			int colMin = width < this->width ? width : this->width;
+				for (int c = 0; c < width; ++c)
+					out[c] = row[columns[c]];
+			}
+		});
 
-			for (int row = 0; row < rowMin; ++row) {
+		return;
+	}
 
-				int* startOfBufferRow = newBuf + width * row;
-				int* startOfThisRow = pPixels + this->width * row;
+	// the rows are scaled into the scratch image, unless only the height changes
+	const int* rows = source;
 
-				// copy row by row
-				memcpy(startOfBufferRow, startOfThisRow, colMin * sizeof(int));
+	if (width != sourceWidth) {
 
-			}
+		ResampleTable table(filter, sourceWidth, width);
 
-		}
-		else {
+		int* scaledRows = height == sourceHeight ? dest : GetScratchImage(width * sourceHeight);
 
-			// they don't want to maintain the image,
-			// just copy everything over
-			memcpy(newBuf, pPixels, GetBufferSize());
-		}
+		ParallelBands(sourceHeight, parallel, [&](int firstRow, int lastRow) {
+			ResampleRowsHorizontal(source, sourceWidth, scaledRows, width, table, firstRow, lastRow);
+		});
 
-		std::swap(newBuf, pPixels);
-		delete[] newBuf;
+		rows = scaledRows;
 	}
 
-	this->width = width;
-	this->height = height;
-	pitch = width * 4;
+	if (height != sourceHeight) {
+
+		ResampleTable table(filter, sourceHeight, height);
+
+		ParallelBands(height, parallel, [&](int firstRow, int lastRow) {
+			ResampleRowsVertical(rows, width, dest, table, firstRow, lastRow);
+		});
+	}
+	else if (rows == source) {
+		memcpy(dest, source, width * height * sizeof(int));
+	}
 
 }
 
-void Surface::Rescale(float xScale, float yScale) {
+void Surface::Rescale(float xScale, float yScale, int filter) {
+
+	MakeEditable();
 
 	if (xScale <= 0 || yScale <= 0)
 		return;
@@ -219,40 +857,43 @@ void Surface::Rescale(float xScale, float yScale) {
 	int newWidth = width * xScale;
 	int newHeight = height * yScale;
 
+	if (newWidth <= 0 || newHeight <= 0)
+		return;
+
 	int* newBuf = new int[newWidth * newHeight];
 	allocatedSpace = newWidth * newHeight;
 
-	for (int row = 0; row < newHeight; ++row) {
-
-		int sampleY = (float)row / newHeight * height;
-
-		for (int col = 0; col < newWidth; ++col) {
-
-			int sampleX = (float)col / newWidth * width;
-
-			newBuf[row * newWidth + col] = pPixels[sampleY * width + sampleX];
+	Resample(pPixels, width, height, newBuf, newWidth, newHeight, filter);
 
-		}
-	}
-
-	std::swap(pPixels, newBuf);
-	delete[] newBuf;
+	ReplacePixels(newBuf);
 
 	width = newWidth;
 	height = newHeight;
 	pitch = width * 4;
 
+}
+
+void Surface::ResampleInto(Surface& target, int filter) {
+
+	MakeEditable();
+	target.MakeEditable();
+
+	Resample(pPixels, width, height, target.pPixels, target.width, target.height, filter);
 
 }
 
 void Surface::WhiteOut() {
 
+	Compress(SURFACE_UNCOMPRESSED);
+
 	memset(pPixels, -1, GetBufferSize());
 
 }
 
 void Surface::BlackOut() {
 
+	Compress(SURFACE_UNCOMPRESSED);
+
 	memset(pPixels, 0, GetBufferSize());
 
 }
@@ -295,34 +936,230 @@ void Surface::DrawLine(int x1, int y1, int x2, int y2, int rgb) {
 
 }
 
-void Surface::GenerateMipMaps() {
+// the source pixels along one axis that make up one pixel of the next level
+struct MipTaps {
 
-	if (mipMap != nullptr)
-		return;
+	int index[3];
+	float weight[3];
+	int count;
+
+};
+
+// even sizes average pairs, odd sizes weight three pixels by how much of each
+// the smaller pixel covers, "Non-Power-of-Two Mipmapping", NVIDIA
+static void GetMipTaps(int sourceSize, int size, std::vector<MipTaps>& taps) {
+
+	taps.resize(size);
+
+	for (int i = 0; i < size; ++i) {
+
+		if (sourceSize == 1)
+			taps[i] = { { 0, 0, 0 }, { 1, 0, 0 }, 1 };
+		else if (sourceSize % 2 == 0)
+			taps[i] = { { 2 * i, 2 * i + 1, 0 }, { 0.5f, 0.5f, 0 }, 2 };
+		else
+			taps[i] = { { 2 * i, 2 * i + 1, 2 * i + 2 }, { (float)(size - i) / sourceSize, (float)size / sourceSize, (float)(i + 1) / sourceSize }, 3 };
+	}
+
+}
+
+// sRGB transfer curve in both directions, alpha is always linear
+struct GammaTables {
+
+	float toLinear[256];
+	unsigned char toSRGB[4096];
+
+	GammaTables() {
+
+		for (int i = 0; i < 256; ++i) {
+
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		for (int i = 0; i < 4096; ++i) {
+
+			float c = i / 4095.0f;
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1 / 2.4f) - 0.055f;
+			toSRGB[i] = (unsigned char)(c * 255 + 0.5f);
+		}
+	}
+
+};
+
+static const GammaTables& GetGammaTables() {
+
+	static GammaTables tables;
+	return tables;
 
-	int mmWidth = width / 2;
-	int mmHeight = height / 2;
+}
+
+// channels of a packed pixel from 0 to 1
+static inline __m128 LoadTexel(int color, const GammaTables* gamma) {
+
+	if (gamma != nullptr)
+		return _mm_setr_ps(gamma->toLinear[color & 0xff], gamma->toLinear[(color >> 8) & 0xff], gamma->toLinear[(color >> 16) & 0xff], ((unsigned int)color >> 24) / 255.0f);
+
+	__m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(color), _mm_setzero_si128()), _mm_setzero_si128());
+	return _mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(1 / 255.0f));
+
+}
+
+static inline int StoreTexel(__m128 color, const GammaTables* gamma) {
+
+	if (gamma != nullptr) {
+
+		__m128i indices = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_setr_ps(4095, 4095, 4095, 255)));
+
+		int i[4];
+		_mm_storeu_si128((__m128i*)i, indices);
+
+		return gamma->toSRGB[i[0]] | gamma->toSRGB[i[1]] << 8 | gamma->toSRGB[i[2]] << 16 | (unsigned int)i[3] << 24;
+	}
+
+	__m128i channels = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255)));
+	channels = _mm_packs_epi32(channels, channels);
+
+	return _mm_cvtsi128_si32(_mm_packus_epi16(channels, channels));
+
+}
+
+// rows firstRow up to lastRow of the next level
+static void DownsampleRows(const int* source, int sourceWidth, int sourceHeight, int* pixels, int width,
+	const MipTaps* xTaps, const MipTaps* yTaps, int firstRow, int lastRow, const GammaTables* gamma)
+{
+
+	// plain 2x2 box, averaged as 16 bit integers two output pixels at a time
+	if (gamma == nullptr && sourceWidth % 2 == 0 && sourceHeight % 2 == 0) {
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(2);
+
+		for (int y = firstRow; y < lastRow; ++y) {
+
+			const int* row1 = source + sourceWidth * 2 * y;
+			const int* row2 = row1 + sourceWidth;
+			int* out = pixels + width * y;
+
+			int x = 0;
+			for (; x + 2 <= width; x += 2) {
+
+				__m128i top = _mm_loadu_si128((const __m128i*)(row1 + 2 * x));
+				__m128i bottom = _mm_loadu_si128((const __m128i*)(row2 + 2 * x));
+
+				// column sums, source pixels 0 and 1 in lo, 2 and 3 in hi
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				// add each pair of columns together
+				__m128i sum = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+
+				_mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(sum, sum));
+			}
+
+			for (; x < width; ++x) {
+
+				const unsigned char* c1 = (const unsigned char*)(row1 + 2 * x);
+				const unsigned char* c2 = (const unsigned char*)(row2 + 2 * x);
+				unsigned char* avg = (unsigned char*)(out + x);
+
+				for (int c = 0; c < 4; ++c)
+					avg[c] = (c1[c] + c1[c + 4] + c2[c] + c2[c + 4] + 2) >> 2;
+			}
+		}
 
-	if (mmWidth < 1 || mmHeight < 1)
 		return;
+	}
+
+	for (int y = firstRow; y < lastRow; ++y) {
+
+		const MipTaps& ty = yTaps[y];
+		int* out = pixels + width * y;
 
-	mipMap = new Surface(mmWidth, mmHeight);
+		for (int x = 0; x < width; ++x) {
 
-	for (int r = 0; r < mmWidth; ++r) {
-		for (int c = 0; c < mmHeight; ++c) {
+			const MipTaps& tx = xTaps[x];
+			__m128 sum = _mm_setzero_ps();
 
-			const Vec4& c1 = GetPixel(r * 2, c * 2);
-			const Vec4& c2 = GetPixel(r * 2 + 1, c * 2);
-			const Vec4& c3 = GetPixel(r * 2, c * 2 + 1);
-			const Vec4& c4 = GetPixel(r * 2 + 1, c * 2 + 1);
+			for (int j = 0; j < ty.count; ++j) {
 
-			Vec4 avg = (c1 + c2 + c3 + c4) / 4;
-			mipMap->PutPixel(r, c, avg);
+				const int* row = source + sourceWidth * ty.index[j];
+				__m128 rowSum = _mm_setzero_ps();
 
+				for (int i = 0; i < tx.count; ++i)
+					rowSum = _mm_add_ps(rowSum, _mm_mul_ps(LoadTexel(row[tx.index[i]], gamma), _mm_set1_ps(tx.weight[i])));
+
+				sum = _mm_add_ps(sum, _mm_mul_ps(rowSum, _mm_set1_ps(ty.weight[j])));
+			}
+
+			out[x] = StoreTexel(sum, gamma);
 		}
 	}
 
-	mipMap->GenerateMipMaps();
+}
+
+void Surface::Downsample(Surface& level, bool gammaCorrect) const {
+
+	std::vector<MipTaps> xTaps, yTaps;
+	GetMipTaps(width, level.width, xTaps);
+	GetMipTaps(height, level.height, yTaps);
+
+	const GammaTables* gamma = gammaCorrect ? &GetGammaTables() : nullptr;
+
+	ParallelBands(level.height, level.width * level.height >= PARALLEL_PIXELS, [&](int firstRow, int lastRow) {
+		DownsampleRows(pPixels, width, height, level.pPixels, level.width, xTaps.data(), yTaps.data(), firstRow, lastRow, gamma);
+	});
+
+}
+
+void Surface::GenerateMipMaps(bool gammaCorrect) {
+
+	if (mipMap != nullptr || (width <= 1 && height <= 1))
+		return;
+
+	// filter plain rows of pixels, then put the whole chain back the way this surface was
+	int finalLayout = layout;
+	int finalCompression = compression;
+
+	MakeEditable();
+
+	// sizes and offsets of every level in the pyramid
+	std::vector<int> widths, heights, offsets;
+	int pyramidSize = 0;
+
+	for (int w = width, h = height; w > 1 || h > 1; ) {
+
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+
+		widths.push_back(w);
+		heights.push_back(h);
+		offsets.push_back(pyramidSize);
+
+		int levelSize = w * h * sizeof(int);
+		pyramidSize += (levelSize + MIP_ALIGNMENT - 1) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+	}
+
+	mipPyramid = (int*)_mm_malloc(pyramidSize, MIP_ALIGNMENT);
+	mipPyramidSize = pyramidSize;
+
+	Surface* previous = this;
+	for (int l = 0; l < (int)widths.size(); ++l) {
+
+		Surface* level = new Surface(mipPyramid + offsets[l] / sizeof(int), widths[l], heights[l], *this);
+		previous->Downsample(*level, gammaCorrect);
+
+		previous->mipMap = level;
+		previous = level;
+	}
+
+	std::cout << "Allocating " << (pyramidSize >> 10) << " KB for " << widths.size() << " mip maps." << std::endl;
+
+	if (finalLayout != SURFACE_LINEAR)
+		SetLayout(finalLayout);
+
+	Compress(finalCompression);
 }
 
 const Surface* Surface::GetMipMap(int level) const {
@@ -335,6 +1172,8 @@ const Surface* Surface::GetMipMap(int level) const {
 
 void Surface::FlipHorizontally() {
 
+	MakeEditable();
+
 	// loop halfway across the image, column by column
 	for (int c = 0; c < width / 2; ++c) {
 
@@ -359,6 +1198,8 @@ void Surface::FlipHorizontally() {
 
 void Surface::FlipVertically() {
 
+	MakeEditable();
+
 	// loop halway down the image, row by row
 	for (int r = 0; r < height / 2; ++r) {
 
@@ -384,6 +1225,8 @@ void Surface::FlipVertically() {
 
 void Surface::RotateRight() {
 
+	MakeEditable();
+
 	int* newBuf = new int[height * width];
 
 	int newHeight = width;
@@ -402,8 +1245,7 @@ void Surface::RotateRight() {
 		}
 	}
 
-	std::swap(newBuf, pPixels);
-	delete[] newBuf;
+	ReplacePixels(newBuf);
 
 	width = newWidth;
 	height = newHeight;
@@ -417,6 +1259,8 @@ void Surface::RotateRight() {
 
 void Surface::RotateLeft() {
 
+	MakeEditable();
+
 	int* newBuf = new int[height * width];
 
 	int newHeight = width;
@@ -435,8 +1279,7 @@ void Surface::RotateLeft() {
 		}
 	}
 
-	std::swap(newBuf, pPixels);
-	delete[] newBuf;
+	ReplacePixels(newBuf);
 
 	width = newWidth;
 	height = newHeight;
@@ -451,6 +1294,8 @@ void Surface::RotateLeft() {
 void Surface::Tint(const Vec4& target, float alpha)
 {
 
+	Compress(SURFACE_UNCOMPRESSED);
+
 	if (alpha < 0)
 		alpha = 0;
 	if (alpha > 1)
@@ -458,8 +1303,8 @@ void Surface::Tint(const Vec4& target, float alpha)
 
 	for (int* traveler = pPixels; traveler < pPixels + width * height; ++traveler) {
 
-		Vec4 tint = EXPAND4(*traveler) * (1 - alpha) + target * alpha;
-		*traveler = COMPRESS4(tint);
+		Vec4 tint = RGBA8::Decode(*traveler) * (1 - alpha) + target * alpha;
+		*traveler = RGBA8::Encode(tint);
 
 	}
 
@@ -479,107 +1324,320 @@ static float SampleGaussianFunction(int x, float stdDev) {
 
 }
 
+// blur weights are fixed point with this many fractional bits
+#define BLUR_WEIGHT_BITS 16
+
+// columns the vertical blur pass works through at a time, so the rows under the kernel stay in cache
+#define BLUR_BLOCK_WIDTH 256
+
+// widens two packed pixels to 8 32 bit channels
+static inline __m256i LoadPixels2(const int* pixels) {
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)pixels));
+}
+
+// rounds 8 fixed point channels back down to two packed pixels
+static inline void StorePixels2(int* pixels, __m256i sum) {
+
+	sum = _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << (BLUR_WEIGHT_BITS - 1))), BLUR_WEIGHT_BITS);
+
+	__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	_mm_storel_epi64((__m128i*)pixels, _mm_packus_epi16(packed, packed));
+
+}
+
+static inline __m128i LoadPixel(const int* pixel) {
+	return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*pixel));
+}
+
+static inline int PackPixel(__m128i sum, int weightBits) {
+
+	sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (weightBits - 1))), weightBits);
+	sum = _mm_packs_epi32(sum, sum);
+
+	return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+
+}
+
+// each row is copied with its edge pixels repeated past both ends, so the taps never leave the row
+static void BlurRowsHorizontal(const int* source, int* dest, int width, int firstRow, int lastRow, const int* weights, int left, int right) {
+
+	int kernelSize = left + right + 1;
+	std::vector<int> padded(left + width + right);
+
+	for (int r = firstRow; r < lastRow; ++r) {
+
+		const int* row = source + width * r;
+
+		std::fill(padded.begin(), padded.begin() + left, row[0]);
+		std::copy(row, row + width, padded.begin() + left);
+		std::fill(padded.begin() + left + width, padded.end(), row[width - 1]);
+
+		int* out = dest + width * r;
+
+		int c = 0;
+		for (; c + 2 <= width; c += 2) {
+
+			__m256i sum = _mm256_setzero_si256();
+
+			for (int w = 0; w < kernelSize; ++w)
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(LoadPixels2(&padded[c + w]), _mm256_set1_epi32(weights[w])));
+
+			StorePixels2(out + c, sum);
+		}
+
+		for (; c < width; ++c) {
+
+			__m128i sum = _mm_setzero_si128();
+
+			for (int w = 0; w < kernelSize; ++w)
+				sum = _mm_add_epi32(sum, _mm_mullo_epi32(LoadPixel(&padded[c + w]), _mm_set1_epi32(weights[w])));
+
+			out[c] = PackPixel(sum, BLUR_WEIGHT_BITS);
+		}
+	}
+
+}
+
+// rows past the top and bottom repeat the edge rows
+static void BlurRowsVertical(const int* source, int* dest, int width, int height, int firstRow, int lastRow, const int* weights, int left, int right) {
+
+	int kernelSize = left + right + 1;
+	std::vector<const int*> rows(kernelSize);
+
+	for (int block = 0; block < width; block += BLUR_BLOCK_WIDTH) {
+
+		int blockEnd = std::min(block + BLUR_BLOCK_WIDTH, width);
+
+		for (int r = firstRow; r < lastRow; ++r) {
+
+			for (int w = 0; w < kernelSize; ++w)
+				rows[w] = source + width * std::min(std::max(r + w - left, 0), height - 1);
+
+			int* out = dest + width * r;
+
+			int c = block;
+			for (; c + 2 <= blockEnd; c += 2) {
+
+				__m256i sum = _mm256_setzero_si256();
+
+				for (int w = 0; w < kernelSize; ++w)
+					sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(LoadPixels2(rows[w] + c), _mm256_set1_epi32(weights[w])));
+
+				StorePixels2(out + c, sum);
+			}
+
+			for (; c < blockEnd; ++c) {
+
+				__m128i sum = _mm_setzero_si128();
+
+				for (int w = 0; w < kernelSize; ++w)
+					sum = _mm_add_epi32(sum, _mm_mullo_epi32(LoadPixel(rows[w] + c), _mm_set1_epi32(weights[w])));
+
+				out[c] = PackPixel(sum, BLUR_WEIGHT_BITS);
+			}
+		}
+	}
+
+}
+
 void Surface::GaussianBlur(int kernelSize, float stdDev, int blurType) {
 
+	MakeEditable();
+
 	if (kernelSize <= 0)
 		return;
 
 	if (stdDev <= 0)
 		return;
 
-	float* weights = new float[kernelSize];
+	// taps on either side of the center
+	int left = kernelSize / 2;
+	int right = kernelSize - 1 - left;
+
+	std::vector<float> gaussian(kernelSize);
 	float sumWeights = 0;
 
 	for (int w = 0; w < kernelSize; ++w) {
 
 		// calculate the weights
-		weights[w] = SampleGaussianFunction(w - (kernelSize / 2), stdDev);
-		sumWeights += weights[w];
+		gaussian[w] = SampleGaussianFunction(w - left, stdDev);
+		sumWeights += gaussian[w];
 
 	}
 
-	// renormalize the weights so they sum to 1
-	for (float* traveler = weights; traveler < weights + kernelSize; ++traveler)
-		*traveler /= sumWeights;
+	// renormalize the weights so they sum to 1 in fixed point, rounding error goes to the center
+	std::vector<int> weights(kernelSize);
+	int sumFixed = 0;
+
+	for (int w = 0; w < kernelSize; ++w) {
+
+		weights[w] = (int)(gaussian[w] / sumWeights * (1 << BLUR_WEIGHT_BITS) + 0.5f);
+		sumFixed += weights[w];
+
+	}
+
+	weights[left] += (1 << BLUR_WEIGHT_BITS) - sumFixed;
+
+	bool parallel = width * height >= PARALLEL_PIXELS;
+	int* scratch = GetScratchImage(width * height);
+
+	// the horizontal pass goes into the scratch image and the vertical pass comes back
+	if (blurType == BLUR_HORIZONTAL || blurType == BLUR_BOTH) {
+
+		ParallelBands(height, parallel, [&](int firstRow, int lastRow) {
+			BlurRowsHorizontal(pPixels, scratch, width, firstRow, lastRow, weights.data(), left, right);
+		});
+	}
+	else {
+		memcpy(scratch, pPixels, width * height * sizeof(int));
+	}
 
-	// do vertical blur
 	if (blurType == BLUR_VERTICAL || blurType == BLUR_BOTH) {
 
-		int* blurredImage = new int[width * height];
+		ParallelBands(height, parallel, [&](int firstRow, int lastRow) {
+			BlurRowsVertical(scratch, pPixels, width, height, firstRow, lastRow, weights.data(), left, right);
+		});
+	}
+	else {
+		memcpy(pPixels, scratch, width * height * sizeof(int));
+	}
+
+	// do operation on mip maps with half the kernel size
+	if (mipMap != nullptr)
+		mipMap->GaussianBlur(kernelSize / 2, stdDev, blurType);
 
-		for (int r = 0; r < height; ++r) {
-			for (int c = 0; c < width; ++c) {
+}
 
-				Vec4 weightedAverage = {};
+// box blurs keep a running sum, so their cost does not depend on the radius
+// the sum is divided by multiplying with a fixed point reciprocal
+#define BOX_WEIGHT_BITS 16
 
-				for (int w = 0; w < kernelSize; ++w) {
+static void BoxRowsHorizontal(const int* source, int* dest, int width, int firstRow, int lastRow, int radius) {
 
-					int offset = w - (kernelSize / 2);
+	__m128i reciprocal = _mm_set1_epi32(((1 << BOX_WEIGHT_BITS) + radius) / (2 * radius + 1));
 
-					// if this offset takes us off the image, ignore this pixel
-					// NOTE: this makes the edges appear darker
-					if (r + offset < 0 || r + offset > height - 1)
-						continue;
+	for (int r = firstRow; r < lastRow; ++r) {
 
-					weightedAverage += EXPAND4(pPixels[width * (r + offset) + c]) * weights[w];
+		const int* row = source + width * r;
+		int* out = dest + width * r;
 
-				}
+		__m128i sum = _mm_setzero_si128();
+		for (int c = -radius; c <= radius; ++c)
+			sum = _mm_add_epi32(sum, LoadPixel(row + std::min(std::max(c, 0), width - 1)));
 
-				blurredImage[width * r + c] = COMPRESS4(weightedAverage);
-			}
+		for (int c = 0; c < width; ++c) {
+
+			out[c] = PackPixel(_mm_mullo_epi32(sum, reciprocal), BOX_WEIGHT_BITS);
+
+			// slide the box one pixel right
+			sum = _mm_add_epi32(sum, LoadPixel(row + std::min(c + radius + 1, width - 1)));
+			sum = _mm_sub_epi32(sum, LoadPixel(row + std::max(c - radius, 0)));
 		}
+	}
+
+}
+
+// walks down the columns together, one row at a time, keeping a sum per column
+static void BoxColumnsVertical(const int* source, int* dest, int width, int height, int firstColumn, int lastColumn, int radius) {
+
+	__m128i reciprocal = _mm_set1_epi32(((1 << BOX_WEIGHT_BITS) + radius) / (2 * radius + 1));
 
-		std::swap(pPixels, blurredImage);
-		delete[] blurredImage;
+	int numColumns = lastColumn - firstColumn;
+	std::vector<__m128i> sums(numColumns, _mm_setzero_si128());
+
+	for (int r = -radius; r <= radius; ++r) {
+
+		const int* row = source + width * std::min(std::max(r, 0), height - 1) + firstColumn;
+
+		for (int c = 0; c < numColumns; ++c)
+			sums[c] = _mm_add_epi32(sums[c], LoadPixel(row + c));
 	}
 
-	// do horizontal blur
-	if (blurType == BLUR_HORIZONTAL || blurType == BLUR_BOTH) {
+	for (int r = 0; r < height; ++r) {
 
-		int* blurredImage = new int[width * height];
+		int* out = dest + width * r + firstColumn;
+		const int* entering = source + width * std::min(r + radius + 1, height - 1) + firstColumn;
+		const int* leaving = source + width * std::max(r - radius, 0) + firstColumn;
 
-		for (int r = 0; r < height; ++r) {
-			for (int c = 0; c < width; ++c) {
+		for (int c = 0; c < numColumns; ++c) {
+
+			out[c] = PackPixel(_mm_mullo_epi32(sums[c], reciprocal), BOX_WEIGHT_BITS);
+			sums[c] = _mm_sub_epi32(_mm_add_epi32(sums[c], LoadPixel(entering + c)), LoadPixel(leaving + c));
+		}
+	}
 
-				Vec4 weightedAverage = {};
+}
 
-				for (int w = 0; w < kernelSize; ++w) {
+void Surface::BoxBlur(float stdDev, int blurType, int passes) {
 
-					int offset = w - (kernelSize / 2);
+	MakeEditable();
 
-					// if this offset takes us off the image, ignore this pixel
-					// NOTE: this makes the edges appear darker
-					if (c + offset < 0 || c + offset > width - 1)
-						continue;
+	if (stdDev <= 0 || passes <= 0)
+		return;
 
-					weightedAverage += EXPAND4(pPixels[width * r + c + offset]) * weights[w];
+	// box widths whose repeated application has the variance of the gaussian
+	// "Fast Almost-Gaussian Filtering", Kovesi
+	float idealWidth = sqrtf(12 * stdDev * stdDev / passes + 1);
 
-				}
+	int lower = (int)idealWidth;
+	if (lower % 2 == 0)
+		--lower;
 
-				blurredImage[width * r + c] = COMPRESS4(weightedAverage);
-			}
+	int upper = lower + 2;
+	int numLower = (int)roundf((12 * stdDev * stdDev - passes * lower * lower - 4 * passes * lower - 3 * passes) / (-4 * lower - 4));
+
+	bool parallel = width * height >= PARALLEL_PIXELS;
+	int* scratch = GetScratchImage(width * height);
+
+	// every pass goes back and forth between the pixels and the scratch image
+	int* source = pPixels;
+	int* dest = scratch;
+
+	for (int pass = 0; pass < passes; ++pass) {
+
+		int radius = ((pass < numLower ? lower : upper) - 1) / 2;
+
+		if (radius <= 0)
+			continue;
+
+		if (blurType == BLUR_HORIZONTAL || blurType == BLUR_BOTH) {
+
+			ParallelBands(height, parallel, [&](int firstRow, int lastRow) {
+				BoxRowsHorizontal(source, dest, width, firstRow, lastRow, radius);
+			});
+
+			std::swap(source, dest);
 		}
 
-		std::swap(pPixels, blurredImage);
-		delete[] blurredImage;
+		if (blurType == BLUR_VERTICAL || blurType == BLUR_BOTH) {
+
+			ParallelBands(width, parallel, [&](int firstColumn, int lastColumn) {
+				BoxColumnsVertical(source, dest, width, height, firstColumn, lastColumn, radius);
+			});
+
+			std::swap(source, dest);
+		}
 	}
-	delete[] weights;
 
-	// do operation on mip maps with half the kernel size
+	if (source != pPixels)
+		memcpy(pPixels, source, width * height * sizeof(int));
+
 	if (mipMap != nullptr)
-		mipMap->GaussianBlur(kernelSize / 2, stdDev, blurType);
+		mipMap->BoxBlur(stdDev / 2, blurType, passes);
 
 }
 
 void Surface::Invert() {
 
+	Compress(SURFACE_UNCOMPRESSED);
+
 	for (int* traveler = pPixels; traveler < pPixels + width * height; ++traveler) {
 
-		Vec4 old = EXPAND4(*traveler);
+		Vec4 old = RGBA8::Decode(*traveler);
 		old.r = 1 - old.r;
 		old.g = 1 - old.g;
 		old.b = 1 - old.b;
-		*traveler = COMPRESS4(old);
+		*traveler = RGBA8::Encode(old);
 
 	}
 
@@ -587,9 +1645,11 @@ void Surface::Invert() {
 
 void Surface::SetContrast(float contrast) {
 
+	Compress(SURFACE_UNCOMPRESSED);
+
 	for (int* traveler = pPixels; traveler < pPixels + width * height; ++traveler) {
 
-		Vec4 old = EXPAND4(*traveler);
+		Vec4 old = RGBA8::Decode(*traveler);
 		
 		old.r -= 0.5;
 		old.r *= (1 + contrast);
@@ -616,7 +1676,7 @@ void Surface::SetContrast(float contrast) {
 			old.b = 0;
 
 
-		*traveler = COMPRESS4(old);
+		*traveler = RGBA8::Encode(old);
 
 	}
 
@@ -624,17 +1684,18 @@ void Surface::SetContrast(float contrast) {
 
 void Surface::DeleteMipMaps() {
 
-	if (mipMap != nullptr) {
+	// each level deletes the levels below it
+	if (mipMap != nullptr)
+		delete mipMap;
 
-		// delete the mip maps mip map, if it exists
-		if (mipMap->mipMap != nullptr)
-			mipMap->DeleteMipMaps();
+	mipMap = nullptr;
 
-		// delete the mip map
-		delete mipMap;
+	// after the levels that point into it
+	if (mipPyramid != nullptr)
+		_mm_free(mipPyramid);
 
-	}
-	
+	mipPyramid = nullptr;
+	mipPyramidSize = 0;
 
 }
 
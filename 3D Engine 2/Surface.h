@@ -3,41 +3,119 @@
 #include <iostream>
 #include "Vec4.h"
 #include "Vec3.h"
+#include "TypedSurface.h"
 
 #define PI 3.14159265358979323846
 
-// returns an integer color value from a Vec4
-#define COMPRESS4(v) ((int)(v.r * 255) | (int)(v.g * 255) << 8 | (int)(v.b * 255) << 16 | (int)(v.a * 255) << 24)
+// pixel orders a surface can store, rows one after another
+#define SURFACE_LINEAR 0
 
-// returns an integer color value from a Vec3
-#define COMPRESS3(v) ((int)(v.r * 255) | (int)(v.g * 255) << 8 | (int)(v.b * 255) << 16 | (unsigned char)-1 << 24)
+// Z-order, the bits of x and y interleaved so pixels that are close in both
+// directions are close in memory, a 4x4 block shares one cache line
+// only for power of two sizes, meant for textures that are sampled but not edited
+#define SURFACE_MORTON 1
 
-// returns a Vec4 from an integer color value
-#define EXPAND4(i) Vec4((i & rMask) / 255.0f, ((i & gMask) >> 8) / 255.0f, ((i & bMask) >> 16) / 255.0f, ((i & aMask) >> 24) / 255.0f )
+// how the pixels are stored, either 32 bit pixels or 4x4 blocks
+#define SURFACE_UNCOMPRESSED 0
 
-// returns a Vec3 from an integer color value
-#define EXPAND3(i) Vec3((i & rMask) / 255.0f, ((i & gMask) >> 8) / 255.0f, ((i & bMask) >> 16) / 255.0f )
+// two 565 colors and a 2 bit index per pixel, 8 bytes per block, no alpha
+#define SURFACE_BC1 1
 
-class Surface
-{
-private:
-	int* pPixels;
-	int width;
-	int height;
+// BC1 colors with a separately interpolated alpha, 16 bytes per block
+#define SURFACE_BC3 2
+
+// red and green interpolated separately, 16 bytes per block
+// meant for normal maps, blue is rebuilt as the z of a unit vector
+#define SURFACE_BC5 3
 
-	int allocatedSpace;
+// decoded blocks each thread keeps around, so neighboring samples do not decode again
+#define BLOCK_CACHE_SIZE 64
+
+class MappedFile;
+
+// the RGBA8 surface used for textures and the window, its pixels are converted
+// by the RGBA8 format, and it can be mip mapped, reordered and compressed
+class Surface : public TypedSurface<RGBA8>
+{
+	friend class PostProcessChain;
 
+private:
 	int pitch;
-	
-	unsigned int aMask;
-	unsigned int rMask;
-	unsigned int gMask;
-	unsigned int bMask;
 
 	Surface* mipMap = nullptr;
 
+	// set when the pixels live in a memory mapped texture file,
+	// the mip maps point into the same mapping and do not own their pixels
+	MappedFile* mapping = nullptr;
+	bool ownsPixels = true;
+
+	// one aligned allocation holding every generated mip level, owned by the top level
+	int* mipPyramid = nullptr;
+	int mipPyramidSize = 0;
+
+	int layout = SURFACE_LINEAR;
+
+	// bits of x and y that are interleaved, the rest of the longer side goes on top
+	int mortonBits = 0;
+
+	// spreads the low 16 bits of v out to the even bits
+	static inline unsigned int SpreadBits(unsigned int v) {
+
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+
+		return v;
+	}
+
+	static inline int PixelIndex(int x, int y, int width, int layout, int mortonBits) {
+
+		if (layout == SURFACE_LINEAR)
+			return width * y + x;
+
+		unsigned int mask = (1u << mortonBits) - 1;
+		return (int)(SpreadBits(x & mask) | SpreadBits(y & mask) << 1 | (unsigned int)(x | y) >> mortonBits << (2 * mortonBits));
+	}
+
+	// where pixel x, y is stored in the current layout
+	inline int PixelIndex(int x, int y) const {
+		return PixelIndex(x, y, width, layout, mortonBits);
+	}
+
+	// compressed surfaces store blocks in rows of blocks in place of pixels
+	int compression = SURFACE_UNCOMPRESSED;
+
+	// identifies these blocks in the per thread block cache
+	unsigned int blockCacheId = 0;
+
+	// decodes the block holding x, y, or finds it in the block cache
+	int DecodeTexel(int x, int y) const;
+
+	// back to plain rows of pixels, for operations that edit or move pixels
+	void MakeEditable();
+
+	// bits interleaved by SURFACE_MORTON at this size, -1 if it is not a power of two
+	static int MortonBits(int width, int height);
+
+	// a level of a mapped mip chain
+	Surface(int* pixels, int width, int height, const Surface& format);
+
+	bool MapTextureFile(const std::string& texturePath, const std::string& sourcePath);
+
+	// frees the current pixels if they are owned and takes ownership of the new ones
+	void ReplacePixels(int* newPixels);
+
+	// after the levels were given their own buffers, moves them into a new pyramid
+	// and frees the old one, which nothing points into anymore
+	void RepackMipMaps();
+
 	std::string GetAllocationString() const;
 
+	// box filters this surface into the next level down, split across threads for large levels
+	void Downsample(Surface& level, bool gammaCorrect) const;
+
 public:
 
 	static constexpr int BPP = 32;
@@ -45,7 +123,9 @@ public:
 	Surface(int width, int height);
 	Surface(const Surface& surface);
 	Surface(Surface&& surface) noexcept;
-	Surface(const std::string& filename);
+	// uses the converted texture next to the image if it is up to date,
+	// or the file itself if it is a converted texture
+	Surface(const std::string& filename, bool useTextureFile = true);
 
 	Surface& operator=(const Surface& surface);
 	Surface& operator=(Surface&& surface) noexcept;
@@ -53,18 +133,43 @@ public:
 	~Surface();
 
 	const int* GetPixels() const;
-	int GetWidth() const;
-	int GetHeight()const;
 	int GetPitch() const;
 	int GetRMask() const;
 	int GetGMask() const;
 	int GetBMask() const;
 	int GetAMask() const;
 	int GetBufferSize() const;
+	// bytes held by this surface and its mip maps, including the mip pyramid
+	size_t GetMemoryUsage() const;
 
 	void Resize(int width, int height, bool maintainImage);
-	void Rescale(float xScale, float yScale);
-	void SetColorMasks(int aMask, int rMask, int gMask, int bMask);
+	enum {
+		FILTER_NEAREST,
+		FILTER_BILINEAR,
+		FILTER_BICUBIC,
+		FILTER_LANCZOS
+	};
+
+	// scales the image by the given factors, filter is one of the FILTER_ values
+	void Rescale(float xScale, float yScale, int filter = FILTER_NEAREST);
+
+	// scales this image into target at target's size, neither surface is reallocated
+	// meant for upscaling a frame rendered at a lower resolution to the window
+	void ResampleInto(Surface& target, int filter);
+
+	// reorders the pixels of this surface and its mip maps, returns false if
+	// the layout is not possible at this size
+	// GetPixel and PutPixel work in any layout, operations that move pixels
+	// around switch back to SURFACE_LINEAR first, as does anything reading GetPixels
+	// that is not aware of the layout
+	bool SetLayout(int layout);
+	int GetLayout() const;
+
+	// block compresses this surface and its mip maps, SURFACE_UNCOMPRESSED decompresses them
+	// compressed surfaces are read only, GetPixel decodes but PutPixel must not be called
+	// operations that edit pixels decompress first
+	void Compress(int format);
+	int GetCompression() const;
 
 	void SaveToFile(const std::string& filename) const;
 
@@ -73,7 +178,9 @@ public:
 
 	void DrawLine(int x1, int y1, int x2, int y2, int rgb);
 
-	void GenerateMipMaps();
+	// builds levels down to 1x1, odd sizes are filtered with three taps so no pixels are dropped
+	// gammaCorrect averages colors in linear space, for textures stored as sRGB
+	void GenerateMipMaps(bool gammaCorrect = false);
 	void DeleteMipMaps();
 	const Surface* GetMipMap(int level) const;
 
@@ -90,41 +197,51 @@ public:
 		BLUR_BOTH
 	};
 
+	// separable blur in fixed point, split across threads, edges repeat the border pixels
 	void GaussianBlur(int kernelSize, float stdDev, int blurType);
 
+	// approximates GaussianBlur with repeated box blurs, which cost the same at any stdDev
+	void BoxBlur(float stdDev, int blurType, int passes = 3);
+
 	void Invert();
 	void SetContrast(float contrast);
 
-	inline const Vec4& GetPixel(int x, int y) const {
+	// the packed pixel at x, y, decoded if the surface is compressed
+	inline int GetTexel(int x, int y) const {
+
+		return compression == SURFACE_UNCOMPRESSED ? pPixels[PixelIndex(x, y)] : DecodeTexel(x, y);
+
+	}
+
+	inline Vec4 GetPixel(int x, int y) const {
 	
-		int color = pPixels[width * y + x];
-		return EXPAND4(color);
+		return RGBA8::Decode(GetTexel(x, y));
 
 	}
 
 	inline void PutPixel(int x, int y, const Vec4& v) {
 
-		pPixels[width * y + x] = COMPRESS4(v);
+		pPixels[PixelIndex(x, y)] = RGBA8::Encode(v);
 
 	}
 
 	inline void PutPixel(int x, int y, const Vec3& v) {
 
-		pPixels[width * y + x] = COMPRESS3(v);
+		pPixels[PixelIndex(x, y)] = RGBA8::Encode({ v.r, v.g, v.b, 1 });
 
 	}
 
 	inline void PutPixel(int x, int y, int rgb) {
 
-		pPixels[width * y + x] = rgb;
+		pPixels[PixelIndex(x, y)] = rgb;
 
 	}
 
 	inline void PutPixel(int x, int y, float grayscale) {
 
 		// memset to the grayscale value * 255, or'd with the Alpha mask so it does not vary in transparency
-		memset(pPixels + width * y + x, (unsigned char)(255 * grayscale), sizeof(int));
-		pPixels[width * y + x] |= aMask;
+		memset(pPixels + PixelIndex(x, y), (unsigned char)(255 * grayscale), sizeof(int));
+		pPixels[PixelIndex(x, y)] |= RGBA8::A_MASK;
 
 	}
 
@@ -0,0 +1,81 @@
+#include "SwapChain.h"
+
+SwapChain::SwapChain(int width, int height)
+	:
+	width(width), height(height), ready(2), closed(false)
+{
+	for (int i = 0; i < 3; ++i)
+		buffers[i] = new Surface(width, height);
+}
+
+SwapChain::~SwapChain() {
+
+	for (int i = 0; i < 3; ++i)
+		delete buffers[i];
+}
+
+void SwapChain::Wake() {
+
+	// taking the lock keeps the notification from landing between
+	// the presenter checking for a frame and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+
+	frameReady.notify_one();
+}
+
+Surface& SwapChain::GetBackBuffer() {
+	return *buffers[back];
+}
+
+void SwapChain::Publish() {
+
+	back = ready.exchange(back | SWAP_FRESH) & SWAP_INDEX;
+
+	Wake();
+
+	// the buffer coming back may have been presented at an older size
+	Surface& surface = *buffers[back];
+
+	if (surface.GetWidth() != width || surface.GetHeight() != height)
+		surface.Resize(width, height, false);
+}
+
+void SwapChain::Resize(int width, int height) {
+
+	this->width = width;
+	this->height = height;
+
+	buffers[back]->Resize(width, height, false);
+}
+
+bool SwapChain::AcquireFront() {
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		frameReady.wait(lock, [this] { return (ready.load() & SWAP_FRESH) || closed.load(); });
+	}
+
+	if (closed.load())
+		return false;
+
+	// the fresh bit is cleared by swapping the old front buffer in without it
+	front = ready.exchange(front) & SWAP_INDEX;
+
+	return true;
+}
+
+Surface& SwapChain::GetFrontBuffer() {
+	return *buffers[front];
+}
+
+void SwapChain::Close() {
+
+	closed.store(true);
+	Wake();
+}
+
+bool SwapChain::IsClosed() const {
+	return closed.load();
+}
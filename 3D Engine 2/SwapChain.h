@@ -0,0 +1,66 @@
+#pragma once
+#include "Surface.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// marks the ready buffer as a frame the presenter has not seen yet
+#define SWAP_FRESH 4
+#define SWAP_INDEX 3
+
+// Three surfaces passed between one thread rendering frames and one presenting them.
+// The renderer owns the back buffer and the presenter owns the front buffer, the third
+// holds the newest finished frame. Publishing swaps the back buffer with that one in a
+// single atomic exchange, so the renderer never waits for the presenter, and the
+// presenter always takes the newest frame, skipping any it was too slow to show.
+class SwapChain
+{
+private:
+
+	Surface* buffers[3];
+
+	// only touched by the rendering thread
+	int back = 0;
+	int width;
+	int height;
+
+	// only touched by the presenting thread
+	int front = 1;
+
+	// index of the newest finished frame, with SWAP_FRESH set until it is acquired
+	std::atomic<int> ready;
+	std::atomic<bool> closed;
+
+	std::mutex mutex;
+	std::condition_variable frameReady;
+
+	void Wake();
+
+public:
+
+	SwapChain(int width, int height);
+	~SwapChain();
+
+	SwapChain(const SwapChain&) = delete;
+	SwapChain& operator=(const SwapChain&) = delete;
+
+	Surface& GetBackBuffer();
+
+	// hands the back buffer to the presenter as the newest frame, and takes
+	// back whichever buffer it replaces. never blocks
+	void Publish();
+
+	// resizes the back buffer now, and the others as they come back to the renderer
+	void Resize(int width, int height);
+
+	// sleeps until a frame newer than the front buffer is published, then makes it
+	// the front buffer. returns false once the chain is closed
+	bool AcquireFront();
+
+	Surface& GetFrontBuffer();
+
+	// wakes the presenter and makes every later AcquireFront return false
+	void Close();
+	bool IsClosed() const;
+
+};
@@ -0,0 +1,95 @@
+#include "TextureFile.h"
+#include "Surface.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <vector>
+
+std::string TextureFile::PathFor(const std::string& sourcePath) {
+	return sourcePath + TEXTURE_FILE_EXTENSION;
+}
+
+bool TextureFile::Write(const std::string& texturePath, const Surface& surface, const std::string& sourcePath) {
+
+	TextureFileHeader header = {};
+	header.version = TEXTURE_FILE_VERSION;
+
+	if (!sourcePath.empty() && !GetFileStamp(sourcePath, header.sourceSize, header.sourceModified))
+		return false;
+
+	header.rMask = surface.GetRMask();
+	header.gMask = surface.GetGMask();
+	header.bMask = surface.GetBMask();
+	header.aMask = surface.GetAMask();
+	header.layout = surface.GetLayout();
+	header.compression = surface.GetCompression();
+
+	// GetMipMap returns the smallest level once the chain runs out
+	std::vector<const Surface*> chain = { &surface };
+	while (chain.back()->GetMipMap(1) != chain.back())
+		chain.push_back(chain.back()->GetMipMap(1));
+
+	header.numLevels = (int)chain.size();
+
+	std::vector<TextureFileLevel> levels(header.numLevels);
+	long long offset = sizeof(TextureFileHeader) + header.numLevels * sizeof(TextureFileLevel);
+
+	for (int l = 0; l < header.numLevels; ++l) {
+
+		offset = (offset + TEXTURE_FILE_ALIGNMENT - 1) / TEXTURE_FILE_ALIGNMENT * TEXTURE_FILE_ALIGNMENT;
+
+		levels[l] = { chain[l]->GetWidth(), chain[l]->GetHeight(), offset };
+		offset += chain[l]->GetBufferSize();
+	}
+
+	std::ofstream out(texturePath, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	// the magic is written last, so a file cut short is never mistaken for a valid texture
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)levels.data(), levels.size() * sizeof(TextureFileLevel));
+
+	for (int l = 0; l < header.numLevels; ++l) {
+
+		// pad up to the level's offset
+		static const char zeros[TEXTURE_FILE_ALIGNMENT] = {};
+		out.write(zeros, levels[l].offset - (long long)out.tellp());
+
+		out.write((const char*)chain[l]->GetPixels(), chain[l]->GetBufferSize());
+	}
+
+	header.magic = TEXTURE_FILE_MAGIC;
+	out.seekp(0);
+	out.write((const char*)&header, sizeof(header));
+
+	return (bool)out;
+
+}
+
+bool TextureFile::Convert(const std::string& sourcePath, int compression) {
+
+	// decode the image itself, even if an older texture exists
+	Surface surface(sourcePath, false);
+
+	if (surface.GetPixels() == nullptr)
+		return false;
+
+	surface.GenerateMipMaps();
+
+	// textures are only sampled, so store them in the form the sampler reads best
+	if (compression != SURFACE_UNCOMPRESSED)
+		surface.Compress(compression);
+	else
+		surface.SetLayout(SURFACE_MORTON);
+
+	std::string texturePath = PathFor(sourcePath);
+
+	if (!Write(texturePath, surface, sourcePath)) {
+		std::cout << "Could not write " << texturePath << std::endl;
+		return false;
+	}
+
+	std::cout << "Converted " << sourcePath << " to " << texturePath << std::endl;
+	return true;
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include "Surface.h"
+
+// "TEX0" read as a little endian int
+#define TEXTURE_FILE_MAGIC 0x30584554
+
+// bump whenever the layout below changes
+#define TEXTURE_FILE_VERSION 2
+
+// appended to the source image's path to name its converted texture
+#define TEXTURE_FILE_EXTENSION ".tex"
+
+// every level starts on a cache line
+#define TEXTURE_FILE_ALIGNMENT 64
+
+// Engine native textures, holding the pixels exactly as a Surface stores
+// them along with the full mip chain, so they can be memory mapped
+// and used without decoding, converting or building mip maps.
+//
+// layout:
+//   TextureFileHeader
+//   TextureFileLevel for each mip level, starting with the full image
+//   the pixels of each level, 32 bits per pixel, rows packed with no padding,
+//   or rows of 4x4 blocks for compressed textures
+
+struct TextureFileHeader {
+
+	int magic;
+	int version;
+
+	// size and modification time of the image the texture was converted from
+	long long sourceSize;
+	long long sourceModified;
+
+	int numLevels;
+
+	unsigned int rMask;
+	unsigned int gMask;
+	unsigned int bMask;
+	unsigned int aMask;
+
+	// SURFACE_LINEAR or SURFACE_MORTON
+	int layout;
+
+	// SURFACE_UNCOMPRESSED or one of the block formats
+	int compression;
+	int reserved;
+
+};
+
+struct TextureFileLevel {
+
+	int width;
+	int height;
+
+	// from the start of the file
+	long long offset;
+
+};
+
+namespace TextureFile {
+
+	std::string PathFor(const std::string& sourcePath);
+
+	// writes a surface and every mip map it has
+	// the source path is stored so stale textures can be detected, it may be empty
+	bool Write(const std::string& texturePath, const Surface& surface, const std::string& sourcePath);
+
+	// decodes an image, builds its mip chain and writes it next to the image
+	// block compressed if a format is given, otherwise stored in morton
+	// order when the image is a power of two
+	bool Convert(const std::string& sourcePath, int compression = SURFACE_UNCOMPRESSED);
+
+}
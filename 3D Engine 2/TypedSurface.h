@@ -0,0 +1,167 @@
+#pragma once
+#include "PixelFormat.h"
+#include <algorithm>
+#include <string.h>
+#include <immintrin.h>
+
+// A width by height grid of pixels in a compile time format.
+// Render targets that are not displayed directly, like depth buffers,
+// G-buffers and HDR targets, use this instead of growing their own class.
+// Surface, in Surface.h, is a TypedSurface<RGBA8> that adds mip maps,
+// layouts and compression for textures.
+template <class Format>
+class TypedSurface
+{
+public:
+
+	typedef typename Format::Storage Storage;
+
+protected:
+
+	Storage* pPixels = nullptr;
+	int width = 0;
+	int height = 0;
+
+	int allocatedSpace = 0;
+
+public:
+
+	TypedSurface() {}
+
+	TypedSurface(int width, int height)
+		:
+		width(width), height(height), allocatedSpace(width * height)
+	{
+		pPixels = new Storage[width * height];
+	}
+
+	TypedSurface(const TypedSurface& surface)
+		:
+		width(surface.width), height(surface.height), allocatedSpace(surface.width * surface.height)
+	{
+		pPixels = new Storage[width * height];
+		std::copy(surface.pPixels, surface.pPixels + width * height, pPixels);
+	}
+
+	TypedSurface(TypedSurface&& surface) noexcept
+		:
+		pPixels(surface.pPixels), width(surface.width), height(surface.height), allocatedSpace(surface.allocatedSpace)
+	{
+		surface.pPixels = nullptr;
+		surface.width = 0;
+		surface.height = 0;
+		surface.allocatedSpace = 0;
+	}
+
+	TypedSurface& operator=(const TypedSurface& surface) {
+
+		if (this == &surface)
+			return *this;
+
+		Resize(surface.width, surface.height);
+		std::copy(surface.pPixels, surface.pPixels + width * height, pPixels);
+
+		return *this;
+	}
+
+	TypedSurface& operator=(TypedSurface&& surface) noexcept {
+
+		std::swap(pPixels, surface.pPixels);
+		std::swap(width, surface.width);
+		std::swap(height, surface.height);
+		std::swap(allocatedSpace, surface.allocatedSpace);
+
+		return *this;
+	}
+
+	~TypedSurface() {
+		delete[] pPixels;
+	}
+
+	// the pixels are left undefined, memory is only reallocated when the surface grows
+	void Resize(int width, int height) {
+
+		if (width <= 0 || height <= 0)
+			return;
+
+		if (width * height > allocatedSpace) {
+
+			delete[] pPixels;
+			pPixels = new Storage[width * height];
+			allocatedSpace = width * height;
+		}
+
+		this->width = width;
+		this->height = height;
+	}
+
+	int GetWidth() const {
+		return width;
+	}
+
+	int GetHeight() const {
+		return height;
+	}
+
+	Storage* GetPixels() {
+		return pPixels;
+	}
+
+	const Storage* GetPixels() const {
+		return pPixels;
+	}
+
+	int GetBufferSize() const {
+		return width * height * sizeof(Storage);
+	}
+
+	// sets every pixel to value, whole AVX registers at a time for 4 and 16 byte formats
+	void Fill(const Storage& value) {
+
+		int count = width * height;
+		int i = 0;
+
+		if constexpr (sizeof(Storage) == 4) {
+
+			int bits;
+			memcpy(&bits, &value, sizeof(int));
+
+			__m256i wide = _mm256_set1_epi32(bits);
+
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_si256((__m256i*)(pPixels + i), wide);
+		}
+		else if constexpr (sizeof(Storage) == 16) {
+
+			__m256 wide = _mm256_broadcast_ps((const __m128*)&value);
+
+			for (; i + 2 <= count; i += 2)
+				_mm256_storeu_ps((float*)(pPixels + i), wide);
+		}
+
+		for (; i < count; ++i)
+			pPixels[i] = value;
+	}
+
+	void Clear(const Vec4& color) {
+		Fill(Format::Encode(color));
+	}
+
+	// the stored value at x, y, without converting it
+	inline const Storage& GetValue(int x, int y) const {
+		return pPixels[width * y + x];
+	}
+
+	inline void PutValue(int x, int y, const Storage& value) {
+		pPixels[width * y + x] = value;
+	}
+
+	inline Vec4 GetPixel(int x, int y) const {
+		return Format::Decode(pPixels[width * y + x]);
+	}
+
+	inline void PutPixel(int x, int y, const Vec4& v) {
+		pPixels[width * y + x] = Format::Encode(v);
+	}
+
+};
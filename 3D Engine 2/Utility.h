@@ -3,9 +3,40 @@
 #include "Vec3.h"
 
 #include <immintrin.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
 
 #define FLOAT_OFFSET(OBJECT, MEMBER) (int)((float*)&OBJECT.MEMBER - (float*)&OBJECT)
 
+// image operations over at least this many pixels are split across threads
+#define PARALLEL_PIXELS (128 * 128)
+
+// calls body(first, last) on bands of 0 to count, one band per core when parallel is set
+// the calling thread takes the last band itself
+template <typename Body>
+static void ParallelBands(int count, bool parallel, const Body& body) {
+
+	int numThreads = parallel ? std::max(1, (int)std::thread::hardware_concurrency()) : 1;
+	int perThread = (count + numThreads - 1) / numThreads;
+
+	std::vector<std::thread> threads;
+
+	for (int first = 0; first < count; first += perThread) {
+
+		int last = std::min(first + perThread, count);
+
+		if (last == count)
+			body(first, last);
+		else
+			threads.emplace_back(body, first, last);
+	}
+
+	for (std::thread& t : threads)
+		t.join();
+
+}
+
 template <class FloatType>
 static FloatType Lerp(const FloatType& p1, const FloatType& p2, float alpha)
 {
@@ -17,13 +48,14 @@ static FloatType Lerp(const FloatType& p1, const FloatType& p2, float alpha)
 
 	if constexpr ( NUMFLOATS % 8 == 0 ) {
 
-		__m256 first = _mm256_set1_ps(alpha);
-		__m256 second = _mm256_set1_ps(1 - alpha);
+		__m256 first = _mm256_set1_ps(1 - alpha);
+		__m256 second = _mm256_set1_ps(alpha);
 
 		for ( int i = 0; i < NUMFLOATS / 8; ++i ) {
 
-			__m256 vec1 = _mm256_load_ps((float*)&p1 + i * 8);
-			__m256 vec2 = _mm256_load_ps((float*)&p1 + i * 8);
+			// pixels are only as aligned as their members, 16 bytes for a Vec4
+			__m256 vec1 = _mm256_loadu_ps((float*)&p1 + i * 8);
+			__m256 vec2 = _mm256_loadu_ps((float*)&p2 + i * 8);
 
 			vec1 = _mm256_mul_ps(vec1, first);
 			vec2 = _mm256_mul_ps(vec2, second);
@@ -1,20 +1,40 @@
 #include "Vec4.h"
 #include "Vec3.h"
 #include <math.h>
+#include <immintrin.h>
+
+static inline __m128 Load(const Vec4& v) {
+	return _mm_loadu_ps(&v.x);
+}
+
+static inline Vec4 Store(__m128 v) {
+
+	Vec4 result;
+	_mm_storeu_ps(&result.x, v);
+
+	return result;
+}
+
+// the sum of all four lanes, in every lane
+static inline __m128 HorizontalSum(__m128 v) {
+
+	__m128 pairs = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+}
 
 Vec4::Vec4() : x(0), y(0), z(0), w(1) {}
 
 Vec4::Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
 
-Vec4::Vec4(const Vec4& v) : x(v.x), y(v.y), z(v.z), w(v.w) {}
+Vec4::Vec4(const Vec4& v) {
 
-Vec4& Vec4::operator=(const Vec4& v) {
+	_mm_storeu_ps(&x, Load(v));
 
-	x = v.x;
-	y = v.y;
-	z = v.z;
-	w = v.w;
+}
 
+Vec4& Vec4::operator=(const Vec4& v) {
+
+	_mm_storeu_ps(&x, Load(v));
 	return *this;
 
 }
@@ -27,46 +47,40 @@ Vec4 Vec4::operator%(const Vec4& v) const {
 
 float Vec4::operator*(const Vec4& v) const {
 
-	return x * v.x + y * v.y + z * v.z + w * v.w;
+	return _mm_cvtss_f32(HorizontalSum(_mm_mul_ps(Load(*this), Load(v))));
 }
 
 Vec4 Vec4::operator+(const Vec4& v) const {
 
-	return { x + v.x, y + v.y, z + v.z, w + v.w };
-	
+	return Store(_mm_add_ps(Load(*this), Load(v)));
+
 }
 Vec4 Vec4::operator-(const Vec4& v) const {
 
-	return { x - v.x, y - v.y, z - v.z, w - v.w };
+	return Store(_mm_sub_ps(Load(*this), Load(v)));
 
 }
 
 Vec4 Vec4::operator*(float s) const {
 
-	return { x * s, y * s, z * s, w * s };
+	return Store(_mm_mul_ps(Load(*this), _mm_set1_ps(s)));
 
 }
 Vec4 Vec4::operator/(float s) const {
 
-	return { x / s, y / s, z / s, w / s };
+	return Store(_mm_div_ps(Load(*this), _mm_set1_ps(s)));
 
 }
 Vec4& Vec4::operator*=(float s) {
 
-	x *= s;
-	y *= s;
-	z *= s;
-	w *= s;
+	_mm_storeu_ps(&x, _mm_mul_ps(Load(*this), _mm_set1_ps(s)));
 
 	return *this;
 
 }
 Vec4& Vec4::operator/=(float s) {
 
-	x /= s;
-	y /= s;
-	z /= s;
-	w /= s;
+	_mm_storeu_ps(&x, _mm_div_ps(Load(*this), _mm_set1_ps(s)));
 
 	return *this;
 
@@ -74,20 +88,14 @@ Vec4& Vec4::operator/=(float s) {
 
 Vec4& Vec4::operator+=(const Vec4& v) {
 
-	x += v.x;
-	y += v.y;
-	z += v.z;
-	w += v.w;
+	_mm_storeu_ps(&x, _mm_add_ps(Load(*this), Load(v)));
 
 	return *this;
 
 }
 Vec4& Vec4::operator-=(const Vec4& v) {
 
-	x -= v.x;
-	y -= v.y;
-	z -= v.z;
-	w -= v.w;
+	_mm_storeu_ps(&x, _mm_sub_ps(Load(*this), Load(v)));
 
 	return *this;
 
@@ -95,17 +103,21 @@ Vec4& Vec4::operator-=(const Vec4& v) {
 
 Vec4 Vec4::operator-() const {
 
-	return { -x, -y, -z , -w};
+	// flips the sign bits
+	return Store(_mm_xor_ps(Load(*this), _mm_set1_ps(-0.0f)));
 
 }
 
 float Vec4::Length() const {
 
-	return sqrtf(x * x + y * y + z * z + w * w);
+	__m128 v = Load(*this);
+	return _mm_cvtss_f32(_mm_sqrt_ss(HorizontalSum(_mm_mul_ps(v, v))));
 
 }
 Vec4 Vec4::Normalized() const {
-	return *this * (1 / Length());
+
+	__m128 v = Load(*this);
+	return Store(_mm_div_ps(v, _mm_sqrt_ps(HorizontalSum(_mm_mul_ps(v, v)))));
 }
 
 Vec4 Vec4::Reflect(const Vec4& normal) const {
@@ -135,7 +147,7 @@ Vec4 Vec4::Refract(const Vec4& normal, float n1, float n2) const {
 }
 
 Vec4 Vec4::Modulate(const Vec4& v1, const Vec4& v2) {
-	return { v1.r * v2.r, v1.g * v2.g, v1.b * v2.b, v1.a * v2.a };
+	return Store(_mm_mul_ps(Load(v1), Load(v2)));
 }
 
 Vec3 Vec4::Vec3() const {
@@ -144,23 +156,7 @@ Vec3 Vec4::Vec3() const {
 
 void Vec4::Clamp()
 {
-	if ( x < 0 )
-		x = 0;
-	if ( y < 0 )
-		y = 0;
-	if ( z < 0 )
-		z = 0;
-	if ( w < 0 )
-		w = 0;
-
-	if ( x > 1 )
-		x = 1;
-	if ( y > 1 )
-		y = 1;
-	if ( z > 1 )
-		z = 1;
-	if ( w > 1 )
-		w = 1;
+	_mm_storeu_ps(&x, _mm_min_ps(_mm_max_ps(Load(*this), _mm_setzero_ps()), _mm_set1_ps(1)));
 }
 
 std::ostream& operator<<(std::ostream& os, const Vec4& v) {
@@ -3,7 +3,9 @@
 
 class Vec3;
 
-class Vec4
+// 16 byte aligned, so the four components sit in one SSE register's worth of memory
+// heap Vec4s rely on C++17's aligned new for this, which every configuration builds with
+class alignas(16) Vec4
 {
 
 public:
@@ -12,56 +12,81 @@ Window::Window(const char* title, int x, int y, int width, int height, int optio
  {
 
 	SDL_CALL(pWindow = SDL_CreateWindow(title, x, y, width, height, options));
-	SDL_CALL(pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC));
-
+	CreateRenderer();
 
 	lastWidth = width;
 	lastHeight = height;
 }
 
-void Window::DrawSurface(const Surface& surface) {
+void Window::CreateRenderer() {
+
+	SDL_CALL(pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC));
+
+	// the dummy and offscreen video drivers only have the software renderer
+	if (pRenderer == nullptr)
+		SDL_CALL(pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_SOFTWARE));
+}
+
+bool Window::PrepareTexture(int width, int height, Uint32 format) {
 
 	if ( lastWidth != GetWidth() || lastHeight != GetHeight() ) {
 
 		// resize detected, this hack is needed because the renderer object
 		// breaks when the window is resized, seems to be an SDL issue
+		// destroying the renderer also destroys its textures
 
 		SDL_CALL(SDL_DestroyRenderer(pRenderer));
-		SDL_CALL(pRenderer = SDL_CreateRenderer(pWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC));
+		CreateRenderer();
+
+		pTexture = nullptr;
 
 		lastWidth = GetWidth();
 		lastHeight = GetHeight();
 	}
 
-	SDL_Surface* pSurface;
-	
-	SDL_CALL(pSurface = SDL_CreateRGBSurfaceFrom(
-		(void*)surface.GetPixels(),
-		surface.GetWidth(),
-		surface.GetHeight(),
+	if ( pTexture != nullptr && textureWidth == width && textureHeight == height && textureFormat == format )
+		return true;
+
+	if ( pTexture != nullptr )
+		SDL_CALL(SDL_DestroyTexture(pTexture));
+
+	SDL_CALL(pTexture = SDL_CreateTexture(pRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height));
+
+	textureWidth = width;
+	textureHeight = height;
+	textureFormat = format;
+
+	return pTexture != nullptr;
+}
+
+void Window::DrawSurface(const Surface& surface) {
+
+	// match the surface's channel order so SDL never has to convert
+	Uint32 format = SDL_MasksToPixelFormatEnum(
 		Surface::BPP,
-		surface.GetPitch(),
 		surface.GetRMask(),
 		surface.GetGMask(),
 		surface.GetBMask(),
 		surface.GetAMask()
-	));
+	);
 
-	SDL_Texture* texture;
+	if ( !PrepareTexture(surface.GetWidth(), surface.GetHeight(), format) )
+		return;
 
-	SDL_CALL(texture = SDL_CreateTextureFromSurface(pRenderer, pSurface));
-	SDL_CALL(SDL_FreeSurface(pSurface));
+	// the only copy the frame goes through on its way to the window
+	SDL_CALL(SDL_UpdateTexture(pTexture, NULL, surface.GetPixels(), surface.GetPitch()));
 
 	SDL_CALL(SDL_RenderClear(pRenderer));
-	SDL_CALL(SDL_RenderCopy(pRenderer, texture, NULL, NULL));
+	SDL_CALL(SDL_RenderCopy(pRenderer, pTexture, NULL, NULL));
 
 	SDL_CALL(SDL_RenderPresent(pRenderer));
-	SDL_CALL(SDL_DestroyTexture(texture));
 
 }
 
 Window::~Window() {
 
+	if ( pTexture != nullptr )
+		SDL_CALL(SDL_DestroyTexture(pTexture));
 	SDL_CALL(SDL_DestroyRenderer(pRenderer));
 	SDL_CALL(SDL_DestroyWindow(pWindow));
 
@@ -11,9 +11,18 @@ private:
 	SDL_Window* pWindow = nullptr;
 	SDL_Renderer* pRenderer = nullptr;
 
+	// streaming texture the frames are copied into, reused until the frame size changes
+	SDL_Texture* pTexture = nullptr;
+	int textureWidth = 0;
+	int textureHeight = 0;
+	Uint32 textureFormat = 0;
+
 	mutable int lastWidth;
 	mutable int lastHeight;
 
+	void CreateRenderer();
+	bool PrepareTexture(int width, int height, Uint32 format);
+
 public:
 	Window(const char* title, int x, int y, int width, int height, int options);
 	~Window();